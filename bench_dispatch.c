@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// bench_dispatch - measures how the dispatcher's cost grows with the number of registered tasks
+//
+// For each task count n = 1, 2, 4, ... <max tasks>, n background tasks are registered with a long
+// period and yield on every release, keeping the dispatcher busy. The measuring task registers with
+// a short period and records how late each of its jobs starts relative to its release grid.
+//
+// The measuring task's voluntary and involuntary context switches per job are reported alongside, and
+// so are the module's own counters from /proc/mp2/cpus (dispatch switches and scheduling policy changes).
+//
+// Output is CSV: tasks,jobs,mean_us,max_us,nvcsw_per_job,nivcsw_per_job,switches,setattrs
+
+#define BG_PERIOD 1000 // milliseconds
+#define BG_PROCESSING_TIME 1 // milliseconds
+#define FG_PERIOD 50 // milliseconds
+#define FG_PROCESSING_TIME 1 // milliseconds
+
+int write_command(const char* command) {
+    FILE* status = fopen("/proc/mp2/status", "w");
+    if (!status) {
+        return -1;
+    }
+    fprintf(status, "%s", command);
+    fclose(status);
+    return 0;
+}
+
+int is_registered(int pid) {
+    FILE* read_ptr = fopen("/proc/mp2/status", "r");
+    if (!read_ptr) {
+        return 0;
+    }
+    int registered = 0;
+    char* line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, read_ptr) != -1) {
+        if (atoi(line) == pid) {
+            registered = 1;
+        }
+    }
+    free(line);
+    fclose(read_ptr);
+    return registered;
+}
+
+// read_module_counters - sums the switches and setattrs counters of every CPU in /proc/mp2/cpus
+void read_module_counters(long long* switches, long long* setattrs) {
+    FILE* cpus = fopen("/proc/mp2/cpus", "r");
+    char* line = NULL;
+    size_t len = 0;
+
+    *switches = 0;
+    *setattrs = 0;
+    if (!cpus) {
+        return;
+    }
+    while (getline(&line, &len, cpus) != -1) {
+        int cpu, util;
+        long long cpu_switches, cpu_setattrs;
+        if (sscanf(line, "cpu %d: util %d, switches %lld, setattrs %lld", &cpu, &util, &cpu_switches, &cpu_setattrs) == 4) {
+            *switches += cpu_switches;
+            *setattrs += cpu_setattrs;
+        }
+    }
+    free(line);
+    fclose(cpus);
+}
+
+double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+// run_background_task - registers, reports it by writing one byte to ready_fd, then yields until killed
+//
+// A task that fails admission exits without writing, so the parent reads end of file instead
+void run_background_task(int ready_fd) {
+    char command[64];
+    int pid = getpid();
+
+    snprintf(command, sizeof(command), "R,%d,%d,%d", pid, BG_PERIOD, BG_PROCESSING_TIME);
+    if (write_command(command) != 0 || !is_registered(pid)) {
+        exit(1);
+    }
+    if (write(ready_fd, "1", 1) != 1) {
+        exit(1);
+    }
+    close(ready_fd);
+
+    FILE* status = fopen("/proc/mp2/status", "w");
+    if (!status) {
+        exit(1);
+    }
+    // yield on every release until the parent kills us
+    while (1) {
+        fprintf(status, "Y,%d", pid);
+        fflush(status);
+    }
+}
+
+int run_measurement(int num_tasks, int num_jobs) {
+    pid_t* children = calloc(num_tasks, sizeof(pid_t));
+    int started = 0;
+    int i;
+
+    // only children that registered count, one that failed admission has already exited
+    for (i = 0; i < num_tasks; i++) {
+        int ready[2];
+        char ok;
+        if (pipe(ready) != 0) {
+            break;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            close(ready[0]);
+            run_background_task(ready[1]);
+        }
+        close(ready[1]);
+        if (child < 0) {
+            close(ready[0]);
+            break;
+        }
+        if (read(ready[0], &ok, 1) == 1) {
+            children[started++] = child;
+        }
+        else {
+            waitpid(child, NULL, 0);
+        }
+        close(ready[0]);
+    }
+    if (started < num_tasks) {
+        fprintf(stderr, "only %d of %d background tasks registered\n", started, num_tasks);
+    }
+
+    char command[64];
+    int pid = getpid();
+    snprintf(command, sizeof(command), "R,%d,%d,%d", pid, FG_PERIOD, FG_PROCESSING_TIME);
+    if (write_command(command) != 0 || !is_registered(pid)) {
+        fprintf(stderr, "failed to register measuring task with %d background tasks\n", started);
+        num_jobs = 0;
+    }
+
+    FILE* status = fopen("/proc/mp2/status", "w");
+    struct rusage usage_before, usage_after;
+    long long switches_before, setattrs_before, switches_after, setattrs_after;
+    getrusage(RUSAGE_SELF, &usage_before);
+    read_module_counters(&switches_before, &setattrs_before);
+
+    double first_release = 0.0;
+    double sum = 0.0;
+    double max = 0.0;
+    int job;
+
+    for (job = 0; job < num_jobs && status; job++) {
+        fprintf(status, "Y,%d", pid);
+        fflush(status);
+
+        // lateness relative to where this job's release should be on the period grid
+        double start = now_us();
+        if (job == 0) {
+            first_release = start;
+        }
+        double lateness = start - (first_release + (double) job * FG_PERIOD * 1000.0);
+        if (lateness < 0.0) {
+            lateness = 0.0;
+        }
+        sum += lateness;
+        if (lateness > max) {
+            max = lateness;
+        }
+    }
+    getrusage(RUSAGE_SELF, &usage_after);
+    read_module_counters(&switches_after, &setattrs_after);
+    if (status) {
+        fprintf(status, "D,%d", pid);
+        fclose(status);
+    }
+
+    for (i = 0; i < started; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+        snprintf(command, sizeof(command), "D,%d", children[i]);
+        write_command(command);
+    }
+    free(children);
+
+    if (num_jobs > 0) {
+        printf("%d,%d,%.1f,%.1f,%.2f,%.2f,%lld,%lld\n", started, num_jobs, sum / num_jobs, max,
+               (double) (usage_after.ru_nvcsw - usage_before.ru_nvcsw) / num_jobs,
+               (double) (usage_after.ru_nivcsw - usage_before.ru_nivcsw) / num_jobs,
+               switches_after - switches_before, setattrs_after - setattrs_before);
+    }
+    return num_jobs > 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc <= 1) {
+        printf("Usage: %s <max tasks> [jobs per run]\n", argv[0]);
+        return 1;
+    }
+
+    int max_tasks = atoi(argv[1]);
+    int num_jobs = argc > 2 ? atoi(argv[2]) : 100;
+    int n;
+
+    printf("tasks,jobs,mean_us,max_us,nvcsw_per_job,nivcsw_per_job,switches,setattrs\n");
+    for (n = 1; n <= max_tasks; n *= 2) {
+        if (run_measurement(n, num_jobs) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
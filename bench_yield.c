@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "mp2_ioctl.h"
+
+// bench_yield - compares the per-yield cost of the /proc/mp2/status text interface and the /dev/mp2 ioctl
+//
+// The task registers with a short period and yields on every job without doing any work. Each yield
+// call is bracketed with the thread's CPU clock, so the time spent asleep waiting for the next release
+// is not counted, only the CPU time the call itself consumes (formatting, syscall entry, parsing, lookup).
+//
+// Output is CSV: interface,yields,mean_us,p50_us,p99_us,max_us
+
+#define PERIOD_US 2000
+#define PROCESSING_TIME_US 100
+
+double thread_cpu_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+int compare_double(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+void report(const char* interface, double* samples, int count) {
+    double sum = 0.0;
+    int i;
+
+    qsort(samples, count, sizeof(double), compare_double);
+    for (i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    printf("%s,%d,%.2f,%.2f,%.2f,%.2f\n", interface, count, sum / count,
+           samples[count / 2], samples[(count * 99) / 100], samples[count - 1]);
+}
+
+int bench_proc(int num_jobs, double* samples) {
+    int pid = getpid();
+    FILE* status = fopen("/proc/mp2/status", "w");
+    if (!status) {
+        return 1;
+    }
+    setvbuf(status, NULL, _IONBF, 0);
+
+    if (fprintf(status, "R,%d,%dus,%dus", pid, PERIOD_US, PROCESSING_TIME_US) < 0) {
+        fclose(status);
+        return 1;
+    }
+
+    int job;
+    fprintf(status, "Y,%d", pid);
+    for (job = 0; job < num_jobs; job++) {
+        double before = thread_cpu_us();
+        fprintf(status, "Y,%d", pid);
+        samples[job] = thread_cpu_us() - before;
+    }
+    fprintf(status, "D,%d", pid);
+    fclose(status);
+    return 0;
+}
+
+int bench_ioctl(int num_jobs, double* samples) {
+    int fd = open(MP2_DEVICE_PATH, O_RDWR);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct mp2_register_args args;
+    memset(&args, 0, sizeof(args));
+    args.period_us = PERIOD_US;
+    args.processing_time_us = PROCESSING_TIME_US;
+    if (ioctl(fd, MP2_IOC_REGISTER, &args) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    struct mp2_job_info job_info;
+    int job;
+    ioctl(fd, MP2_IOC_YIELD, &job_info);
+    for (job = 0; job < num_jobs; job++) {
+        double before = thread_cpu_us();
+        ioctl(fd, MP2_IOC_YIELD, &job_info);
+        samples[job] = thread_cpu_us() - before;
+    }
+    ioctl(fd, MP2_IOC_DEREGISTER);
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int num_jobs = argc > 1 ? atoi(argv[1]) : 1000;
+    if (num_jobs <= 0) {
+        printf("Usage: %s [yields per interface]\n", argv[0]);
+        return 1;
+    }
+
+    double* samples = calloc(num_jobs, sizeof(double));
+    printf("interface,yields,mean_us,p50_us,p99_us,max_us\n");
+
+    if (bench_proc(num_jobs, samples) != 0) {
+        fprintf(stderr, "failed to register through /proc/mp2/status\n");
+        return 1;
+    }
+    report("proc", samples, num_jobs);
+
+    if (bench_ioctl(num_jobs, samples) != 0) {
+        fprintf(stderr, "failed to register through %s\n", MP2_DEVICE_PATH);
+        return 1;
+    }
+    report("ioctl", samples, num_jobs);
+
+    free(samples);
+    return 0;
+}
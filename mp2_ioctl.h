@@ -0,0 +1,67 @@
+#ifndef __MP2_IOCTL_INCLUDE__
+#define __MP2_IOCTL_INCLUDE__
+
+// Binary interface of /dev/mp2, shared by the module and user applications
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define MP2_DEVICE_NAME "mp2"
+#define MP2_DEVICE_PATH "/dev/mp2"
+
+// MP2_IOC_REGISTER, MP2_IOC_REGISTER_SERVER and MP2_IOC_UPDATE argument, pid 0 means the calling process
+struct mp2_register_args {
+        __s32 pid;
+        __u32 reserved;
+        __u64 period_us;
+        __u64 processing_time_us;
+};
+
+// MP2_IOC_YIELD result, the job that starts when the call returns
+// Times are CLOCK_MONOTONIC nanoseconds
+struct mp2_job_info {
+        __u64 release_ns;
+        __u64 deadline_ns;
+};
+
+// read() from a task fd (MP2_IOC_TASK_FD), the latest job dispatched since the previous read
+// job numbers start at 1 and count every job of the task, a job is reported when it is first dispatched
+struct mp2_release_event {
+        __u64 release_ns; // CLOCK_MONOTONIC
+        __u64 job;
+};
+
+// MP2_IOC_REGISTER_BATCH and MP2_IOC_UPDATE_BATCH argument, tasks points to count struct mp2_register_args
+// Either every task is registered (or updated) or none is
+#define MP2_BATCH_MAX 1024
+struct mp2_batch_args {
+        __u64 tasks;
+        __u32 count;
+        __u32 reserved;
+};
+
+// One command in the command log, /sys/kernel/debug/mp2/commands<cpu> while the module's record parameter is set
+// 32 bytes, so relay sub-buffers hold whole records and each file is a plain array of them
+struct mp2_record {
+        __u64 time_ns; // CLOCK_MONOTONIC when the command was received
+        __u64 period_us; // R, S, U, B and V, 0 otherwise
+        __u64 processing_time_us;
+        __s32 pid; // pid the command applies to
+        __s16 ret; // 0 or the negative errno the command returned
+        __u8 op; // 'R', 'S', 'I', 'U', 'Y', 'N' (non-blocking yield), 'A', 'D', 'B' or 'V' (one record per task of a batch)
+        __u8 reserved;
+};
+
+#define MP2_IOC_MAGIC 'm'
+#define MP2_IOC_REGISTER _IOW(MP2_IOC_MAGIC, 1, struct mp2_register_args)
+#define MP2_IOC_YIELD _IOR(MP2_IOC_MAGIC, 2, struct mp2_job_info)
+#define MP2_IOC_DEREGISTER _IO(MP2_IOC_MAGIC, 3)
+#define MP2_IOC_REGISTER_BATCH _IOW(MP2_IOC_MAGIC, 4, struct mp2_batch_args)
+#define MP2_IOC_UPDATE _IOW(MP2_IOC_MAGIC, 5, struct mp2_register_args)
+#define MP2_IOC_REGISTER_SERVER _IOW(MP2_IOC_MAGIC, 6, struct mp2_register_args) // processing_time_us is the server budget
+#define MP2_IOC_SUBMIT _IO(MP2_IOC_MAGIC, 7) // the argument is the server's pid
+#define MP2_IOC_TASK_FD _IO(MP2_IOC_MAGIC, 8) // the argument is a pid or 0, returns a pollable task fd
+#define MP2_IOC_YIELD_NB _IOR(MP2_IOC_MAGIC, 9, struct mp2_job_info) // ends the job without waiting
+#define MP2_IOC_UPDATE_BATCH _IOW(MP2_IOC_MAGIC, 10, struct mp2_batch_args)
+
+#endif
@@ -0,0 +1,156 @@
+#include "mp2_policy.h"
+
+#ifdef __KERNEL__
+#include <linux/math64.h>
+#include <linux/time64.h>
+#define mp2_div64(a, b) div64_u64((a), (b))
+#else
+#define NSEC_PER_USEC 1000LL
+#define mp2_div64(a, b) ((a) / (b))
+#endif
+
+void mp2_entity_init(struct mp2_entity* e, u64 period, u64 processing_time) {
+        e->period = period;
+        e->processing_time = processing_time;
+        e->release_time = 0;
+        e->deadline = 0;
+        e->jobs = 0;
+        e->missed = 0;
+        e->next_period = 0;
+        e->next_processing_time = 0;
+}
+
+int mp2_params_valid(u64 period, u64 processing_time) {
+        return period != 0 && processing_time != 0 && processing_time <= period && period <= MP2_MAX_TIME_US;
+}
+
+int mp2_task_util(u64 processing_time, u64 period) {
+        return mp2_div64(processing_time * MP2_UTIL_SCALE + period - 1, period);
+}
+
+int mp2_entity_before(int policy, const struct mp2_entity* a, const struct mp2_entity* b) {
+        if (policy == MP2_POLICY_EDF) {
+                return a->deadline < b->deadline;
+        }
+        return a->period < b->period;
+}
+
+int mp2_admit_util(int util_sum, const struct mp2_entity* cand) {
+        return util_sum + mp2_task_util(cand->processing_time, cand->period) <= MP2_UTIL_BOUND;
+}
+
+int mp2_admit_edf(int util_sum, const struct mp2_entity* cand) {
+        return util_sum + mp2_task_util(cand->processing_time, cand->period) <= MP2_UTIL_SCALE;
+}
+
+// _rta_fits - whether a task with period and processing_time converges to a worst-case response time
+// within its period, interfered with by every task in tasks (other than tasks[self]) with a period no
+// longer than its own and by cand if it is not NULL
+static int _rta_fits(const struct mp2_entity* tasks, int n, int self,
+                     u64 period, u64 processing_time, const struct mp2_entity* cand) {
+        u64 response = processing_time;
+        int i;
+
+        while (1) {
+                u64 next = processing_time;
+                for (i = 0; i < n && tasks[i].period <= period; i++) {
+                        if (i != self) {
+                                next += mp2_div64(response + tasks[i].period - 1, tasks[i].period) * tasks[i].processing_time;
+                        }
+                }
+                if (cand != NULL && cand->period <= period) {
+                        next += mp2_div64(response + cand->period - 1, cand->period) * cand->processing_time;
+                }
+
+                if (next > period) {
+                        return 0;
+                }
+                if (next == response) {
+                        return 1;
+                }
+                response = next;
+        }
+}
+
+int mp2_admit_rta(const struct mp2_entity* tasks, int n, const struct mp2_entity* cand) {
+        int util_sum = mp2_task_util(cand->processing_time, cand->period);
+        int i;
+
+        for (i = 0; i < n; i++) {
+                util_sum += mp2_task_util(tasks[i].processing_time, tasks[i].period);
+        }
+        if (util_sum > MP2_UTIL_SCALE) {
+                return 0;
+        }
+
+        if (!_rta_fits(tasks, n, -1, cand->period, cand->processing_time, NULL)) {
+                return 0;
+        }
+        for (i = 0; i < n; i++) {
+                if (tasks[i].period >= cand->period &&
+                    !_rta_fits(tasks, n, i, tasks[i].period, tasks[i].processing_time, cand)) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+// _apply_update - takes a pending update as the job at release_time starts
+static void _apply_update(struct mp2_entity* e) {
+        if (e->next_period != 0) {
+                e->period = e->next_period;
+                e->processing_time = e->next_processing_time;
+                e->next_period = 0;
+                e->next_processing_time = 0;
+        }
+}
+
+int mp2_entity_yield(struct mp2_entity* e, s64 now) {
+        if (e->release_time == 0) { // if the task just registered, its first job is released now
+                e->release_time = now;
+        }
+        else { // the next job is released when the current one's period ends
+                e->jobs++;
+                if (now > e->deadline) {
+                        e->missed++;
+                }
+                e->release_time = e->deadline;
+        }
+        _apply_update(e);
+        e->deadline = e->release_time + (s64) e->period * NSEC_PER_USEC;
+
+        return now >= e->release_time;
+}
+
+void mp2_entity_replenish(struct mp2_entity* e) {
+        e->missed++;
+        e->release_time = e->deadline;
+        _apply_update(e);
+        e->deadline = e->release_time + (s64) e->period * NSEC_PER_USEC;
+}
+
+void mp2_entity_resume(struct mp2_entity* e, s64 release, s64 now) {
+        s64 period = (s64) e->period * NSEC_PER_USEC;
+        s64 next = release;
+
+        // move to the first release at or after now in whole periods
+        if (next < now) {
+                next += (s64) mp2_div64(now - next + period - 1, period) * period;
+        }
+        else {
+                next -= (s64) mp2_div64(next - now, period) * period;
+        }
+        e->release_time = next - period;
+        e->deadline = next;
+}
+
+void mp2_entity_update(struct mp2_entity* e, u64 period, u64 processing_time, int between_jobs) {
+        e->next_period = period;
+        e->next_processing_time = processing_time;
+        if (between_jobs) {
+                _apply_update(e);
+                if (e->release_time != 0) {
+                        e->deadline = e->release_time + (s64) e->period * NSEC_PER_USEC;
+                }
+        }
+}
@@ -0,0 +1,83 @@
+#ifndef __MP2_POLICY_INCLUDE__
+#define __MP2_POLICY_INCLUDE__
+
+// Scheduling policy core shared by the kernel module and the userspace simulator (mp2sim)
+//
+// It holds the decisions, not the mechanisms: admission tests, the priority order of tasks and the
+// per-job release/yield state machine. It never locks, allocates or sleeps, so the module can call it
+// under its spinlocks and the simulator can call it from a plain event loop.
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t s64;
+#endif
+
+#define MP2_UTIL_SCALE 10000 // utilization fixed point, 10000 = one full CPU
+#define MP2_UTIL_BOUND 6930 // Liu-Layland bound for large task sets, ln 2
+// longest period and processing time accepted, one day in microseconds. It keeps period * NSEC_PER_USEC,
+// absolute deadlines in nanoseconds, processing_time * MP2_UTIL_SCALE and response-time sums far from overflow
+#define MP2_MAX_TIME_US 86400000000ULL
+
+// scheduling policies
+#define MP2_POLICY_RM 0 // rate monotonic, fixed priority by period
+#define MP2_POLICY_EDF 1 // earliest deadline first, dynamic priority by absolute deadline
+
+// mp2_entity - the policy's view of one periodic task
+// Times are microseconds for parameters and absolute nanoseconds for job times
+struct mp2_entity {
+        u64 period;
+        u64 processing_time;
+        s64 release_time; // release of the current or next job, 0 before the first yield
+        s64 deadline; // deadline of that job, release_time + period
+        u64 jobs; // jobs completed
+        u64 missed; // jobs completed after their deadline, or still running when their period ended
+        u64 next_period; // period from the next release on, 0 if no update is pending
+        u64 next_processing_time;
+};
+
+void mp2_entity_init(struct mp2_entity* e, u64 period, u64 processing_time);
+
+// mp2_params_valid - whether a task may have period and processing_time: both non-zero, processing_time no
+// longer than period and period at most MP2_MAX_TIME_US. Every entry point checks parameters with it
+int mp2_params_valid(u64 period, u64 processing_time);
+
+// mp2_task_util - utilization of a task in MP2_UTIL_SCALE units, rounded up so admission never under-counts it
+int mp2_task_util(u64 processing_time, u64 period);
+
+// mp2_entity_before - whether a has strictly higher priority than b under policy
+// Rate monotonic orders by period, EDF by the deadline of the current or next job
+int mp2_entity_before(int policy, const struct mp2_entity* a, const struct mp2_entity* b);
+
+// mp2_admit_util - O(1) utilization bound test of adding cand to a CPU whose utilization is util_sum
+int mp2_admit_util(int util_sum, const struct mp2_entity* cand);
+
+// mp2_admit_edf - O(1) exact EDF test for implicit deadlines, utilization including cand at most one CPU
+int mp2_admit_edf(int util_sum, const struct mp2_entity* cand);
+
+// mp2_admit_rta - exact response-time test of adding cand to the n tasks of a CPU
+// tasks must be sorted by period. Only cand and the tasks it can preempt are rechecked
+int mp2_admit_rta(const struct mp2_entity* tasks, int n, const struct mp2_entity* cand);
+
+// mp2_entity_yield - ends the current job at now, or starts the first one, and sets up the next job
+// Returns 1 if the next job is already released, 0 if the task sleeps until e->release_time
+int mp2_entity_yield(struct mp2_entity* e, s64 now);
+
+// mp2_entity_replenish - moves a job that was still running when its period ended into the next period
+void mp2_entity_replenish(struct mp2_entity* e);
+
+// mp2_entity_resume - puts a task that hasn't yielded yet on an existing release grid, given any release on it
+// The job in progress ends by the first grid release at or after now, and the task's next job is released there
+void mp2_entity_resume(struct mp2_entity* e, s64 release, s64 now);
+
+// mp2_entity_update - changes a task's period and processing time from its next release on
+// A task between jobs (its next job not released yet, or never yielded) takes them for that next job,
+// whose release stays where it is and whose deadline moves. Otherwise the running job keeps the old
+// parameters and the update is applied when the job yields or is replenished
+void mp2_entity_update(struct mp2_entity* e, u64 period, u64 processing_time, int between_jobs);
+
+#endif
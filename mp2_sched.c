@@ -0,0 +1,2495 @@
+#define LINUX
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/sort.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/lockdep.h>
+#include <linux/kthread.h>
+#include <linux/rbtree.h>
+#include <linux/hashtable.h>
+#include <linux/llist.h>
+#include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/kref.h>
+#include <linux/poll.h>
+#include <linux/anon_inodes.h>
+#include <linux/relay.h>
+#include <linux/debugfs.h>
+#include <linux/rcupdate.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/overflow.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/seq_file.h>
+#include <linux/rculist.h>
+#include <uapi/linux/sched/types.h>
+#include "mp2_given.h"
+#include "mp2_ioctl.h"
+#include "mp2_policy.h"
+
+#define CREATE_TRACE_POINTS
+#include "mp2_trace.h"
+#include "linux/list.h"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Group_ID");
+MODULE_DESCRIPTION("CS-423 MP2");
+
+#define DEBUG 1
+
+#define PID_TABLE_BITS 8
+#define MP2_DISPATCH_PRIO 99 // dispatch threads preempt every scheduled task
+#define MP2_MAX_PRIO 98 // SCHED_FIFO priority of the shortest period on a CPU
+#define MP2_MIN_PRIO 1
+#define MP2_MAX_REPL 16 // pending replenishments per sporadic server, later ones are merged into the last
+#define MP2_RECORD_SUBBUF_SIZE (64 * 1024) // a multiple of sizeof(struct mp2_record), so no record straddles sub-buffers
+#define MP2_RECORD_SUBBUFS 8
+#define MP2_CMD_MAX 96 // longest /proc/mp2/status command other than 'B' (an 'I' line), parsed from a stack buffer
+#define HIST_BUCKETS 16 // log2 microsecond buckets, bucket 0 is < 1us and the last one collects everything longer
+
+// admission_mode values
+#define ADMISSION_UTIL_BOUND 0 // Liu-Layland utilization bound, sum(C/T) <= 0.693
+#define ADMISSION_RTA 1 // exact response-time analysis
+
+int admission_mode = ADMISSION_UTIL_BOUND;
+module_param(admission_mode, int, 0644);
+MODULE_PARM_DESC(admission_mode, "0 = utilization bound (default), 1 = exact response-time analysis");
+
+// placement values
+#define PLACEMENT_FIRST_FIT 0 // lowest numbered CPU that admits the task
+#define PLACEMENT_WORST_FIT 1 // least utilized CPU that admits the task
+
+int placement = PLACEMENT_FIRST_FIT;
+module_param(placement, int, 0644);
+MODULE_PARM_DESC(placement, "0 = first-fit (default), 1 = worst-fit");
+
+// sched_policy is fixed for the lifetime of the module, the ready queues are ordered by it
+int sched_policy = MP2_POLICY_RM;
+module_param(sched_policy, int, 0444);
+MODULE_PARM_DESC(sched_policy, "0 = rate monotonic (default), 1 = earliest deadline first");
+
+bool budget_enforcement = true;
+module_param(budget_enforcement, bool, 0644);
+MODULE_PARM_DESC(budget_enforcement, "Throttle jobs that run past their processing time until their next release (default on)");
+
+// Every command can be logged to a relay channel in debugfs, for mp2replay to turn into a load test
+bool record = false;
+module_param(record, bool, 0644);
+MODULE_PARM_DESC(record, "Log every command with its time and result to /sys/kernel/debug/mp2/commands<cpu> (default off)");
+
+// Task objects are preallocated at load time, so the task limit is fixed and registration only allocates the
+// task's /proc/mp2/tasks entry
+int max_tasks = 1024;
+module_param(max_tasks, int, 0444);
+MODULE_PARM_DESC(max_tasks, "Tasks preallocated at load time, registrations past it fail with ENOSPC (default 1024)");
+
+enum task_state { RUNNING, READY, SLEEPING, THROTTLED };
+const char* task_state_names[] = { "RUNNING", "READY", "SLEEPING", "THROTTLED" };
+
+// mp2_stats - per-task timing statistics, updated on the dispatch and yield paths under the task's CPU lock
+// All durations are nanoseconds
+struct mp2_stats {
+        ktime_t job_release; // release time of the current job
+        ktime_t job_start; // when the current job was first dispatched, 0 until it runs
+        u64 exec_start; // linux_task's sum_exec_runtime at job_start
+        u64 started; // jobs that were dispatched
+        u64 finished; // jobs that were dispatched and then yielded
+        u64 latency_sum; // release to first dispatch
+        u64 latency_min;
+        u64 latency_max;
+        u64 response_sum; // release to yield
+        u64 response_max;
+        u64 exec_sum; // CPU time consumed per job
+        u64 exec_max;
+        u32 latency_hist[HIST_BUCKETS];
+        u32 response_hist[HIST_BUCKETS];
+};
+// mp2_repl - a sporadic server replenishment, amount ns of capacity returned at time
+struct mp2_repl {
+        ktime_t time;
+        u64 amount;
+};
+
+struct mp2_task_struct {
+        struct task_struct* linux_task; // represents the PCB, referenced until the task is returned to the pool
+        struct hrtimer wakeup_timer; // fires at release_time, or at deadline to replenish a THROTTLED task, or at a server's next replenishment
+        struct hrtimer budget_timer; // fires when the running job exhausts its processing_time
+        struct list_head list; // node in registered_processes
+        struct list_head cpu_list; // node in its mp2_cpu's tasks
+        struct hlist_node pid_node; // node in pid_table
+        struct rb_node ready_node; // node in its mp2_cpu's ready_queue while state == READY
+        struct rcu_head rcu;
+        int pid;
+        int cpu; // CPU the task is partitioned onto, fixed at registration
+        cpumask_var_t cpus_allowed; // linux_task's affinity before it was pinned to cpu, restored at deregistration
+        struct mp2_entity entity; // period and processing time in microseconds, release time and deadline as ktime_t
+        int util; // what the task adds to its CPU's util_sum, protected by registry_lock
+        u64 rank_period; // period the task is sorted and ranked by on its CPU, protected by registry_lock
+        bool update_applied; // an update took effect at a release and util and rank_period don't reflect it yet
+        const struct mp2_entity* staged; // parameters a batch update admitted for the task, NULL otherwise, protected by registry_lock
+        enum task_state state;
+        u64 budget_used; // CPU time in ns the current job consumed before it was last dispatched
+        ktime_t run_start; // when the task was last dispatched, the job is charged the time it stays RUNNING from then
+        u64 overruns; // times the task was throttled for exhausting its budget
+        int rt_priority; // SCHED_FIFO priority from its period rank on its CPU, MP2_MAX_PRIO under EDF
+        bool promoted; // chosen to run under SCHED_FIFO at rt_priority, _sync_sched applies it
+        int applied_priority; // SCHED_FIFO priority last applied to linux_task, 0 for SCHED_NORMAL, protected by its CPU's sched_lock
+        struct mp2_stats stats;
+        struct proc_dir_entry* stats_entry; // /proc/mp2/tasks/<pid>
+        struct llist_node release_node; // node in its mp2_cpu's releases while release_queued is set
+        atomic_t release_queued;
+        wait_queue_head_t wait; // yielders waiting to be dispatched and pollers of the task's fds
+        bool release_signalled; // the current job was reported through the task's fds, at its first dispatch
+        u64 releases; // jobs dispatched so far, the job number reported through the task's fds
+        ktime_t last_release; // release time of job number releases
+        bool dead; // deregistered, waiters and fd readers give up
+        struct kref ref; // held by the registration, open task fds and blocked yielders, the last put frees the task
+
+        // sporadic server state, entity.processing_time is the server's budget and entity.period its replenishment period
+        bool server; // serves submitted aperiodic jobs instead of periodic releases
+        bool serving; // a server job is in progress
+        u64 pending_jobs; // submitted jobs not finished yet, including the one in progress
+        u64 capacity; // ns of budget left, budget_used is what the current busy interval consumed of it
+        ktime_t activation; // start of the current busy interval, 0 while the server is idle or exhausted
+        struct mp2_repl repl[MP2_MAX_REPL]; // pending replenishments in time order, a ring starting at repl_head
+        int repl_head;
+        int repl_count;
+};
+
+// mp2_cpu - scheduling state of one CPU, every CPU schedules only the tasks partitioned onto it
+struct mp2_cpu {
+        spinlock_t lock; // protects ready_queue, current_mp2_task and the state of this CPU's tasks
+        struct mutex sched_lock; // serializes applying this CPU's tasks' scheduling policies, which may sleep
+        struct rb_root_cached ready_queue; // READY tasks ordered by sched_policy, leftmost runs next
+        struct mp2_task_struct* current_mp2_task;
+        struct task_struct* dispatch_thread;
+        struct llist_head releases; // tasks whose wakeup_timer fired, published without the lock and drained by the dispatcher
+        struct list_head tasks; // tasks on this CPU sorted by rank_period, protected by registry_lock
+        int util_sum; // sum of util over tasks, protected by registry_lock
+        struct work_struct update_work; // settles tasks whose update took effect at a release
+        struct work_struct exit_work; // deregisters tasks whose process exited without deregistering
+        int cpu;
+        u64 switches; // dispatch decisions that changed the running task
+        u64 setattrs; // scheduling policy changes made by the module, protected by sched_lock
+        u64 released; // wakeup_timer expirations handled
+        u64 release_batches; // non-empty drains of releases, released / release_batches is the coalescing factor
+};
+DEFINE_PER_CPU(struct mp2_cpu, mp2_cpus);
+
+LIST_HEAD(registered_processes); // all registered tasks, readers may walk it under rcu_read_lock
+DEFINE_HASHTABLE(pid_table, PID_TABLE_BITS); // pid -> mp2_task_struct, readers may look up under rcu_read_lock
+DEFINE_MUTEX(registry_lock); // serializes registration and deregistration, protects the registry and admission state
+bool stopping; // the module is unloading and refuses registrations, protected by registry_lock
+struct kmem_cache *mp2_cache;
+LIST_HEAD(task_pool); // free preallocated tasks, linked through their list node
+DEFINE_SPINLOCK(task_pool_lock); // also taken from RCU callbacks
+struct dentry* debug_dir; // /sys/kernel/debug/mp2
+struct rchan* record_chan; // command log, NULL if debugfs is unavailable
+struct mp2_entity* rta_scratch; // 3 * max_tasks entries for response-time analysis snapshots, protected by registry_lock
+struct proc_dir_entry* tasks_dir; // /proc/mp2/tasks
+
+// get_mp2_struct - O(1) lookup of a registered task by pid
+// Caller must hold rcu_read_lock or registry_lock
+struct mp2_task_struct* get_mp2_struct(int pid) {
+        struct mp2_task_struct* task;
+
+        hash_for_each_possible_rcu(pid_table, task, pid_node, pid, lockdep_is_held(&registry_lock)) {
+                if (task->pid == pid) {
+                        return task;
+                }
+        }
+        return NULL;
+}
+
+struct mp2_cpu* task_rq(struct mp2_task_struct* task) {
+        return per_cpu_ptr(&mp2_cpus, task->cpu);
+}
+
+// _task_exited - whether the task's process is exiting or gone. Its task_struct stays valid since the task holds
+// a reference, but it must not be scheduled or reconfigured anymore
+bool _task_exited(struct mp2_task_struct* task) {
+        return READ_ONCE(task->linux_task->flags) & PF_EXITING;
+}
+
+// _admitted_entity - the parameters a task is admitted with, including an update not yet applied
+// Caller must hold registry_lock
+struct mp2_entity _admitted_entity(struct mp2_task_struct* task) {
+        struct mp2_entity admitted = task->entity;
+
+        if (admitted.next_period != 0) {
+                admitted.period = admitted.next_period;
+                admitted.processing_time = admitted.next_processing_time;
+        }
+        return admitted;
+}
+
+// _charged_util - what a task must be charged for: until a pending update takes effect the current job still
+// runs with the old parameters, so it is charged the larger of its old and new utilization
+// Caller must hold the task's CPU lock
+int _charged_util(struct mp2_task_struct* task) {
+        int util = mp2_task_util(task->entity.processing_time, task->entity.period);
+
+        if (task->entity.next_period != 0) {
+                util = max(util, mp2_task_util(task->entity.next_processing_time, task->entity.next_period));
+        }
+        return util;
+}
+
+// _update_applied - records that a release applied a task's pending update. util_sum and the ranks are
+// protected by registry_lock, which can't be taken here, so the CPU's update_work settles them
+// Caller must hold the task's CPU lock
+void _update_applied(struct mp2_task_struct* task) {
+        task->update_applied = true;
+        schedule_work(&(task_rq(task)->update_work));
+}
+
+// _free_task - returns a task to task_pool, no RCU reader may see it anymore
+void _free_task(struct mp2_task_struct* task) {
+        unsigned long flags;
+
+        if (task->linux_task != NULL) {
+                put_task_struct(task->linux_task);
+                task->linux_task = NULL;
+        }
+        spin_lock_irqsave(&task_pool_lock, flags);
+        list_add(&(task->list), &task_pool);
+        spin_unlock_irqrestore(&task_pool_lock, flags);
+}
+
+// free_mp2_task_rcu - returns a deregistered task to task_pool once no RCU reader can see it
+void free_mp2_task_rcu(struct rcu_head* head) {
+        struct mp2_task_struct* task = container_of(head, struct mp2_task_struct, rcu);
+        _free_task(task);
+}
+
+// mp2_task_release - frees a task once its registration and every fd and yielder holding it are gone
+void mp2_task_release(struct kref* ref) {
+        struct mp2_task_struct* task = container_of(ref, struct mp2_task_struct, ref);
+        call_rcu(&(task->rcu), free_mp2_task_rcu);
+}
+
+// _ready_queue_insert - adds a READY task to its CPU's ready queue in policy order, ties keep insertion order
+// Caller must hold the CPU's lock
+void _ready_queue_insert(struct mp2_cpu* rq, struct mp2_task_struct* task) {
+        struct rb_node** link = &(rq->ready_queue.rb_root.rb_node);
+        struct rb_node* parent = NULL;
+        bool leftmost = true;
+
+        while (*link) {
+                struct mp2_task_struct* entry = rb_entry(*link, struct mp2_task_struct, ready_node);
+                parent = *link;
+                if (mp2_entity_before(sched_policy, &(task->entity), &(entry->entity))) {
+                        link = &((*link)->rb_left);
+                }
+                else {
+                        link = &((*link)->rb_right);
+                        leftmost = false;
+                }
+        }
+        rb_link_node(&(task->ready_node), parent, link);
+        rb_insert_color_cached(&(task->ready_node), &(rq->ready_queue), leftmost);
+}
+
+// _ready_queue_remove - removes a task from its CPU's ready queue if it is queued
+// Caller must hold the CPU's lock
+void _ready_queue_remove(struct mp2_cpu* rq, struct mp2_task_struct* task) {
+        if (!RB_EMPTY_NODE(&(task->ready_node))) {
+                rb_erase_cached(&(task->ready_node), &(rq->ready_queue));
+                RB_CLEAR_NODE(&(task->ready_node));
+        }
+}
+
+// _set_task_state - changes a task's state and keeps ready queue membership in sync with it
+// Caller must hold the task's CPU's lock
+void _set_task_state(struct mp2_task_struct* task, enum task_state state) {
+        struct mp2_cpu* rq = task_rq(task);
+
+        if (task->state == READY && state != READY) {
+                _ready_queue_remove(rq, task);
+        }
+        else if (task->state != READY && state == READY) {
+                _ready_queue_insert(rq, task);
+        }
+        WRITE_ONCE(task->state, state);
+}
+
+// _get_shortest_ready_task - O(1) peek at the READY task with the highest priority on a CPU
+// The running task keeps the CPU unless the policy orders the ready task strictly before it
+// Caller must hold the CPU's lock
+struct mp2_task_struct* _get_shortest_ready_task(struct mp2_cpu* rq) {
+        struct mp2_task_struct* next_task = NULL;
+        struct rb_node* leftmost = rb_first_cached(&(rq->ready_queue));
+
+        if (leftmost != NULL) {
+                next_task = rb_entry(leftmost, struct mp2_task_struct, ready_node);
+        }
+        if (rq->current_mp2_task != NULL && rq->current_mp2_task->state == RUNNING) {
+                if (next_task != NULL) {
+                        if (!mp2_entity_before(sched_policy, &(next_task->entity), &(rq->current_mp2_task->entity))) {
+                                return rq->current_mp2_task;
+                        }
+                }
+        }
+        return next_task;
+}
+
+int _hist_bucket(u64 ns) {
+        int bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+        return min(bucket, HIST_BUCKETS - 1);
+}
+
+// _record_job_start - accounts the first dispatch of a task's current job
+// Caller must hold the task's CPU lock
+void _record_job_start(struct mp2_task_struct* task, ktime_t now) {
+        struct mp2_stats* stats = &(task->stats);
+        u64 latency;
+
+        if (stats->job_start != 0 || task->entity.release_time == 0) {
+                return;
+        }
+        stats->job_release = task->entity.release_time;
+        stats->job_start = now;
+        stats->exec_start = task->linux_task->se.sum_exec_runtime;
+
+        latency = ktime_to_ns(ktime_sub(now, task->entity.release_time));
+        if (stats->started == 0 || latency < stats->latency_min) {
+                stats->latency_min = latency;
+        }
+        stats->latency_max = max(stats->latency_max, latency);
+        stats->latency_sum += latency;
+        stats->latency_hist[_hist_bucket(latency)]++;
+        stats->started++;
+}
+
+// _record_job_end - accounts the response and execution time of a job that yields at now
+// Caller must hold the task's CPU lock
+void _record_job_end(struct mp2_task_struct* task, ktime_t now) {
+        struct mp2_stats* stats = &(task->stats);
+        u64 response;
+        u64 exec;
+
+        if (stats->job_start == 0) {
+                return;
+        }
+        response = ktime_to_ns(ktime_sub(now, stats->job_release));
+        exec = task->linux_task->se.sum_exec_runtime - stats->exec_start;
+
+        stats->response_max = max(stats->response_max, response);
+        stats->response_sum += response;
+        stats->response_hist[_hist_bucket(response)]++;
+        stats->exec_max = max(stats->exec_max, exec);
+        stats->exec_sum += exec;
+        stats->finished++;
+        stats->job_start = 0;
+}
+
+// _budget - the budget in ns that budget_used is checked against, a server's remaining capacity
+u64 _budget(struct mp2_task_struct* task) {
+        return task->server ? task->capacity : task->entity.processing_time * NSEC_PER_USEC;
+}
+
+// _start_budget - arms the budget timer for what is left of the current job's budget as the task is dispatched
+// Servers always enforce their capacity, the guarantees of the periodic tasks depend on it
+// Caller must hold the task's CPU lock
+void _start_budget(struct mp2_task_struct* task) {
+        u64 budget = _budget(task);
+
+        task->run_start = ktime_get();
+        if (budget_enforcement || task->server) {
+                u64 remaining = budget > task->budget_used ? budget - task->budget_used : 0;
+                hrtimer_start(&(task->budget_timer), ns_to_ktime(remaining), HRTIMER_MODE_REL_PINNED);
+        }
+}
+
+// _stop_budget - charges the time since _start_budget to the current job and disarms the budget timer
+// A callback already running on another CPU sees the task is no longer RUNNING and does nothing
+// Caller must hold the task's CPU lock
+void _stop_budget(struct mp2_task_struct* task) {
+        ktime_t now = ktime_get();
+
+        hrtimer_try_to_cancel(&(task->budget_timer));
+        task->budget_used += ktime_to_ns(ktime_sub(now, task->run_start));
+        task->run_start = now;
+}
+
+// _server_add_repl - schedules amount ns of capacity to be returned to a server at time
+// Replenishments are added in time order, so the wakeup_timer only has to be armed for the first one
+// Caller must hold the task's CPU lock
+void _server_add_repl(struct mp2_task_struct* task, ktime_t time, u64 amount) {
+        if (task->repl_count == MP2_MAX_REPL) {
+                // out of slots, returning the capacity later than due is always safe
+                struct mp2_repl* last = &(task->repl[(task->repl_head + task->repl_count - 1) % MP2_MAX_REPL]);
+                last->time = time;
+                last->amount += amount;
+                return;
+        }
+        task->repl[(task->repl_head + task->repl_count) % MP2_MAX_REPL] = (struct mp2_repl) { time, amount };
+        task->repl_count++;
+        if (task->repl_count == 1) {
+                hrtimer_start(&(task->wakeup_timer), time, HRTIMER_MODE_ABS);
+        }
+}
+
+// _publish_release - marks a released job to be reported through the task's fds once it is dispatched
+// Caller must hold the task's CPU lock
+void _publish_release(struct mp2_task_struct* task) {
+        task->release_signalled = false;
+}
+
+// _signal_release - reports a job through the task's fds when it is first dispatched, so a task that waits
+// for its jobs on a fd only runs them once it has been promoted to its SCHED_FIFO priority
+// The caller wakes the task's waiters
+// Caller must hold the task's CPU lock
+void _signal_release(struct mp2_task_struct* task) {
+        if (!task->release_signalled) {
+                task->release_signalled = true;
+                task->releases++;
+                task->last_release = task->entity.release_time;
+        }
+}
+
+// _server_activate - starts a busy interval and a job for a server with pending jobs and capacity left
+// Caller must hold the task's CPU lock
+void _server_activate(struct mp2_task_struct* task, ktime_t now) {
+        task->activation = now;
+        task->serving = true;
+        task->entity.release_time = now;
+        task->entity.deadline = ktime_add_us(now, task->entity.period);
+        _set_task_state(task, READY);
+        _publish_release(task);
+}
+
+// _server_end_interval - ends a server's busy interval, the capacity it consumed is replenished one
+// period after the interval started (the sporadic server replenishment rule)
+// Caller must hold the task's CPU lock
+void _server_end_interval(struct mp2_task_struct* task) {
+        u64 used = min(task->budget_used, task->capacity);
+
+        task->capacity -= used;
+        if (used > 0) {
+                _server_add_repl(task, ktime_add_us(task->activation, task->entity.period), used);
+        }
+        task->activation = 0;
+        task->budget_used = 0;
+}
+
+// budget_timer_callback - throttles a running job that has used up its processing_time, or a server that has used up its capacity
+// A job is charged the wall time it is RUNNING as the current task: sum_exec_runtime only advances at ticks and
+// context switches, so read from this hardirq it could be a tick behind and let the job overrun by that much.
+// Time the task spends blocked or preempted by anything outside the module while current is charged too,
+// which can only throttle it early. The timer re-arms itself if the budget grew since it was armed, as a
+// server's capacity does when a replenishment arrives while it runs
+enum hrtimer_restart budget_timer_callback(struct hrtimer* timer) {
+        struct mp2_task_struct* task = container_of(timer, struct mp2_task_struct, budget_timer);
+        struct mp2_cpu* rq = task_rq(task);
+        enum hrtimer_restart restart = HRTIMER_NORESTART;
+        int throttled = 0;
+        unsigned long flags;
+
+        spin_lock_irqsave(&(rq->lock), flags);
+        if (task->state == RUNNING && rq->current_mp2_task == task) {
+                u64 budget = _budget(task);
+                u64 used = task->budget_used + ktime_to_ns(ktime_sub(ktime_get(), task->run_start));
+
+                if (used < budget) {
+                        hrtimer_forward_now(timer, ns_to_ktime(budget - used));
+                        restart = HRTIMER_RESTART;
+                }
+                else {
+                        // throttled until the period ends, the dispatcher demotes it
+                        _stop_budget(task);
+                        _set_task_state(task, THROTTLED);
+                        task->overruns++;
+                        trace_mp2_throttle(task->pid, task->cpu, task->budget_used, task->entity.deadline);
+                        if (task->server) {
+                                // exhausted until a replenishment arrives
+                                _server_end_interval(task);
+                        }
+                        else {
+                                hrtimer_start(&(task->wakeup_timer), task->entity.deadline, HRTIMER_MODE_ABS);
+                        }
+                        throttled = 1;
+                }
+        }
+        spin_unlock_irqrestore(&(rq->lock), flags);
+
+        if (throttled) {
+                wake_up_process(rq->dispatch_thread);
+        }
+        return restart;
+}
+
+void _set_sched(struct task_struct* linux_task, int policy, int priority) {
+        struct sched_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.sched_policy = policy;
+        attr.sched_priority = priority;
+        sched_setattr_nocheck(linux_task, &attr);
+}
+
+// _promote - chooses SCHED_FIFO at its rate-monotonic priority for a task, _sync_sched applies it
+// Caller must hold the task's CPU lock
+void _promote(struct mp2_task_struct* task) {
+        task->promoted = true;
+}
+
+// _demote - chooses SCHED_NORMAL for a task, _sync_sched applies it
+// Caller must hold the task's CPU lock
+void _demote(struct mp2_task_struct* task) {
+        task->promoted = false;
+}
+
+// _sync_sched - applies the policy chosen for a task by _promote, _demote and _assign_priorities
+// sched_setattr_nocheck may sleep, so the choice is made under the task's CPU lock and applied here once it
+// is dropped. Whoever changes the choice syncs afterwards and sched_lock orders the syncs, so the policy
+// applied last is always the latest choice. Nothing is applied to a process that is exiting
+// Caller must hold a reference to the task and must not hold its CPU lock
+void _sync_sched(struct mp2_task_struct* task) {
+        struct mp2_cpu* rq = task_rq(task);
+        int priority;
+
+        mutex_lock(&(rq->sched_lock));
+        spin_lock_irq(&(rq->lock));
+        priority = task->promoted ? task->rt_priority : 0;
+        spin_unlock_irq(&(rq->lock));
+        if (priority != task->applied_priority && !_task_exited(task)) {
+                _set_sched(task->linux_task, priority != 0 ? SCHED_FIFO : SCHED_NORMAL, priority);
+                task->applied_priority = priority;
+                rq->setattrs++;
+        }
+        mutex_unlock(&(rq->sched_lock));
+}
+
+// _assign_priorities - gives the tasks on a CPU distinct SCHED_FIFO priorities by period rank
+// The shortest period gets MP2_MAX_PRIO and every longer period one less, equal periods share a priority
+// and ranks past MP2_MIN_PRIO share the lowest one. Only promoted tasks whose rank changed are touched, once
+// the CPU's lock is dropped.
+// Under EDF priorities are dynamic, every task runs at MP2_MAX_PRIO and only the dispatched one is promoted.
+// Caller must hold registry_lock
+void _assign_priorities(struct mp2_cpu* rq) {
+        struct mp2_task_struct* tmp;
+        u64 last_period = 0;
+        int priority = MP2_MAX_PRIO + 1;
+
+        spin_lock_irq(&(rq->lock));
+        list_for_each_entry(tmp, &(rq->tasks), cpu_list) {
+                u64 period = tmp->rank_period;
+                if (sched_policy == MP2_POLICY_EDF) {
+                        priority = MP2_MAX_PRIO;
+                }
+                else if (period != last_period) {
+                        priority = max(priority - 1, MP2_MIN_PRIO);
+                        last_period = period;
+                }
+                tmp->rt_priority = priority;
+        }
+        spin_unlock_irq(&(rq->lock));
+
+        // registry_lock keeps the tasks on the list
+        list_for_each_entry(tmp, &(rq->tasks), cpu_list) {
+                _sync_sched(tmp);
+        }
+}
+
+// _server_replenish - returns every due replenishment to a server's capacity, an exhausted server with
+// pending jobs starts a new busy interval. Returns when the next replenishment is due, 0 if none is pending
+// Caller must hold the task's CPU lock
+ktime_t _server_replenish(struct mp2_task_struct* task, ktime_t now) {
+        u64 budget = task->entity.processing_time * NSEC_PER_USEC;
+
+        while (task->repl_count > 0 && ktime_compare(task->repl[task->repl_head].time, now) <= 0) {
+                task->capacity = min(task->capacity + task->repl[task->repl_head].amount, budget);
+                task->repl_head = (task->repl_head + 1) % MP2_MAX_REPL;
+                task->repl_count--;
+        }
+        if (task->state == THROTTLED && task->capacity > 0) {
+                if (task->pending_jobs > 0) {
+                        _server_activate(task, now);
+                        trace_mp2_release(task->pid, task->cpu, task->entity.period,
+                                          task->entity.release_time, task->entity.deadline, true);
+                }
+                else {
+                        _set_task_state(task, SLEEPING);
+                }
+        }
+        return task->repl_count > 0 ? task->repl[task->repl_head].time : 0;
+}
+
+// _release_task - handles an expired wakeup_timer: releases a SLEEPING job, replenishes a THROTTLED one, or
+// returns due capacity to a server and re-arms its timer for the next replenishment
+// Caller must hold the task's CPU lock
+void _release_task(struct mp2_task_struct* task, ktime_t now) {
+        if (task->server) {
+                ktime_t next = _server_replenish(task, now);
+                if (next != 0) {
+                        hrtimer_start(&(task->wakeup_timer), next, HRTIMER_MODE_ABS);
+                }
+        }
+        else {
+                bool replenished = task->state == THROTTLED;
+                if (replenished) {
+                        bool pending = task->entity.next_period != 0;
+                        // the throttled job missed its deadline, it continues with a fresh budget in the new period
+                        mp2_entity_replenish(&(task->entity));
+                        task->budget_used = 0;
+                        if (pending) {
+                                _update_applied(task);
+                        }
+                }
+                _set_task_state(task, READY);
+                _publish_release(task);
+                trace_mp2_release(task->pid, task->cpu, task->entity.period,
+                                  task->entity.release_time, task->entity.deadline, replenished);
+        }
+}
+
+// _drain_releases - handles every release published to a CPU since the last drain in one pass
+// Caller must hold the CPU's lock
+void _drain_releases(struct mp2_cpu* rq) {
+        struct llist_node* batch = llist_del_all(&(rq->releases));
+        struct mp2_task_struct* task;
+        struct mp2_task_struct* tmp;
+        ktime_t now;
+
+        if (batch == NULL) {
+                return;
+        }
+        now = ktime_get();
+        rq->release_batches++;
+        // published newest first, handled in expiry order
+        llist_for_each_entry_safe(task, tmp, llist_reverse_order(batch), release_node) {
+                atomic_set(&(task->release_queued), 0);
+                rq->released++;
+                // skip tasks that were deregistered after their timer fired
+                if (hash_hashed(&(task->pid_node))) {
+                        _release_task(task, now);
+                }
+        }
+}
+
+// wakeup_timer_callback - publishes a release to the task's CPU without taking its lock
+// Simultaneous releases (harmonic periods firing on the same tick) don't contend on the CPU lock in
+// timer context, and the dispatcher handles them all in its next pass
+enum hrtimer_restart wakeup_timer_callback(struct hrtimer* timer) {
+        struct mp2_task_struct* expired_task = container_of(timer, struct mp2_task_struct, wakeup_timer);
+        struct mp2_cpu* rq = task_rq(expired_task);
+
+        if (atomic_xchg(&(expired_task->release_queued), 1) == 0) {
+                llist_add(&(expired_task->release_node), &(rq->releases));
+        }
+
+        // wakeup this CPU's dispatch thread
+        wake_up_process(rq->dispatch_thread);
+        return HRTIMER_NORESTART;
+}
+
+// _drop_exited - stops dispatching tasks whose process exited without deregistering, the CPU's exit_work
+// deregisters them. Only the running task and the head of the ready queue are checked, any other exited
+// task is dropped once it gets there
+// Caller must hold the CPU's lock
+void _drop_exited(struct mp2_cpu* rq) {
+        struct mp2_task_struct* task = rq->current_mp2_task;
+        struct rb_node* leftmost;
+        bool dropped = false;
+
+        if (task != NULL && _task_exited(task)) {
+                if (task->state == RUNNING) {
+                        _stop_budget(task);
+                }
+                _set_task_state(task, SLEEPING);
+                rq->current_mp2_task = NULL;
+                dropped = true;
+        }
+        while ((leftmost = rb_first_cached(&(rq->ready_queue))) != NULL) {
+                task = rb_entry(leftmost, struct mp2_task_struct, ready_node);
+                if (!_task_exited(task)) {
+                        break;
+                }
+                _set_task_state(task, SLEEPING);
+                dropped = true;
+        }
+        if (dropped) {
+                schedule_work(&(rq->exit_work));
+        }
+}
+
+int dispatch_callback(void* arguments) {
+        struct mp2_cpu* rq = arguments;
+
+        while (!kthread_should_stop()) {
+                // tasks whose policy changed, applied once the lock is dropped
+                struct mp2_task_struct* demoted = NULL;
+                struct mp2_task_struct* promoted = NULL;
+
+                // find task on this CPU with READY state and the highest priority under sched_policy
+                spin_lock_irq(&(rq->lock));
+                _drain_releases(rq);
+                _drop_exited(rq);
+                struct mp2_task_struct* current_mp2_task = rq->current_mp2_task;
+                struct mp2_task_struct* next_task = _get_shortest_ready_task(rq);
+
+                // a throttled task is demoted until its budget is replenished
+                if (current_mp2_task != NULL && current_mp2_task->state == THROTTLED) {
+                        _demote(current_mp2_task);
+                        demoted = current_mp2_task;
+                        rq->current_mp2_task = NULL;
+                        current_mp2_task = NULL;
+                }
+                trace_mp2_dispatch(rq->cpu, current_mp2_task != NULL ? current_mp2_task->pid : -1,
+                                   next_task != NULL ? next_task->pid : -1, next_task != NULL ? next_task->entity.deadline : 0);
+
+                // nothing to do if there are no READY tasks or the current task keeps running; a current task
+                // that is READY yielded into an already released job and is dispatched again
+                if (next_task != NULL && (next_task != current_mp2_task || next_task->state != RUNNING)) {
+                        if (current_mp2_task != NULL && current_mp2_task != next_task) {
+                                // old task set to READY if it was RUNNING. Under RM it keeps its lower FIFO priority so
+                                // the kernel resumes it as soon as next_task blocks, under EDF every task shares
+                                // one priority so it has to be demoted to be preempted
+                                if (current_mp2_task->state == RUNNING) {
+                                        _stop_budget(current_mp2_task);
+                                        _set_task_state(current_mp2_task, READY);
+                                }
+                                if (sched_policy == MP2_POLICY_EDF) {
+                                        _demote(current_mp2_task);
+                                        demoted = current_mp2_task;
+                                }
+                        }
+                        _set_task_state(next_task, RUNNING);
+                        _record_job_start(next_task, ktime_get());
+                        _start_budget(next_task);
+
+                        // prioritize new task, a no-op unless it was demoted, and wake it if it is blocked in a yield
+                        // or waiting for the job on a task fd
+                        _promote(next_task);
+                        promoted = next_task;
+                        _signal_release(next_task);
+                        wake_up_interruptible(&(next_task->wait));
+
+                        // reset what current_mp2_task points to
+                        if (next_task != current_mp2_task) {
+                                trace_mp2_switch(rq->cpu, current_mp2_task != NULL ? current_mp2_task->pid : -1, next_task->pid,
+                                                 next_task->entity.period, next_task->entity.deadline);
+                                rq->switches++;
+                        }
+                        rq->current_mp2_task = next_task;
+                }
+                // apply the policy changes, which may sleep, then look again since releases may have arrived
+                // meanwhile. A task on the ready queue or current isn't deregistered yet, so it can be referenced
+                if (demoted != NULL || promoted != NULL) {
+                        if (demoted != NULL) {
+                                kref_get(&(demoted->ref));
+                        }
+                        if (promoted != NULL) {
+                                kref_get(&(promoted->ref));
+                        }
+                        spin_unlock_irq(&(rq->lock));
+                        if (demoted != NULL) {
+                                _sync_sched(demoted);
+                                kref_put(&(demoted->ref), mp2_task_release);
+                        }
+                        if (promoted != NULL) {
+                                _sync_sched(promoted);
+                                kref_put(&(promoted->ref), mp2_task_release);
+                        }
+                        continue;
+                }
+                // put dispatch_thread to sleep. The state is set before the lock is dropped so a waker that changes
+                // state under the lock can't be missed, and releases published since the drain are checked after it,
+                // as is a kthread_stop that woke the thread before it was TASK_INTERRUPTIBLE
+                set_current_state(TASK_INTERRUPTIBLE);
+                spin_unlock_irq(&(rq->lock));
+                if (llist_empty(&(rq->releases)) && !kthread_should_stop()) {
+                        schedule();
+                }
+                __set_current_state(TASK_RUNNING);
+        }
+
+        return 0;
+}
+
+// /proc/mp2/status is read through seq_file, walking registered_processes under RCU so readers never
+// take registry_lock or a CPU lock and can't stall registration or dispatch
+void* status_seq_start(struct seq_file* m, loff_t* pos) __acquires(RCU) {
+        struct mp2_task_struct* task;
+        loff_t i = 0;
+
+        rcu_read_lock();
+        list_for_each_entry_rcu(task, &registered_processes, list) {
+                if (i++ == *pos) {
+                        return task;
+                }
+        }
+        return NULL;
+}
+
+void* status_seq_next(struct seq_file* m, void* v, loff_t* pos) {
+        struct mp2_task_struct* task = v;
+
+        ++*pos;
+        return list_next_or_null_rcu(&registered_processes, &(task->list), struct mp2_task_struct, list);
+}
+
+void status_seq_stop(struct seq_file* m, void* v) __releases(RCU) {
+        rcu_read_unlock();
+}
+
+// status_seq_show - one line per task: "<pid>: <period>us, <processing time>us, <state>, cpu <cpu>, deadline <ns>, jobs <n>, missed <n>"
+int status_seq_show(struct seq_file* m, void* v) {
+        struct mp2_task_struct* task = v;
+
+        seq_printf(m, "%d: %lluus, %lluus, %s, cpu %d, deadline %lld, jobs %llu, missed %llu\n",
+                   task->pid, task->entity.period, task->entity.processing_time, task_state_names[READ_ONCE(task->state)],
+                   task->cpu, ktime_to_ns(READ_ONCE(task->entity.deadline)), READ_ONCE(task->entity.jobs), READ_ONCE(task->entity.missed));
+        return 0;
+}
+
+const struct seq_operations status_seq_ops = {
+        .start = status_seq_start,
+        .next = status_seq_next,
+        .stop = status_seq_stop,
+        .show = status_seq_show,
+};
+
+int proc_open_callback(struct inode* inode, struct file* file) {
+        return seq_open(file, &status_seq_ops);
+}
+
+void _seq_print_hist(struct seq_file* m, const char* name, u32* hist) {
+        int i;
+
+        seq_printf(m, "%s:", name);
+        for (i = 0; i < HIST_BUCKETS - 1; i++) {
+                seq_printf(m, " <%u:%u", 1U << i, hist[i]);
+        }
+        seq_printf(m, " >=%u:%u\n", 1U << (HIST_BUCKETS - 1), hist[HIST_BUCKETS - 1]);
+}
+
+// task_stats_show - /proc/mp2/tasks/<pid>, a snapshot of one task's statistics
+int task_stats_show(struct seq_file* m, void* v) {
+        struct mp2_task_struct* task = m->private;
+        struct mp2_cpu* rq = task_rq(task);
+        struct mp2_stats stats;
+        ktime_t release_time;
+        u64 jobs, missed, overruns, capacity, pending_jobs;
+
+        spin_lock_irq(&(rq->lock));
+        stats = task->stats;
+        capacity = task->capacity;
+        pending_jobs = task->pending_jobs;
+        release_time = task->entity.release_time;
+        jobs = task->entity.jobs;
+        missed = task->entity.missed;
+        overruns = task->overruns;
+        spin_unlock_irq(&(rq->lock));
+
+        seq_printf(m, "pid: %d\n", task->pid);
+        seq_printf(m, "cpu: %d\n", task->cpu);
+        seq_printf(m, "period_us: %llu\n", task->entity.period);
+        seq_printf(m, "processing_time_us: %llu\n", task->entity.processing_time);
+        seq_printf(m, "jobs: %llu\n", jobs);
+        seq_printf(m, "missed: %llu\n", missed);
+        seq_printf(m, "overruns: %llu\n", overruns);
+        if (task->server) {
+                seq_printf(m, "server_capacity_ns: %llu\n", capacity);
+                seq_printf(m, "pending_jobs: %llu\n", pending_jobs);
+        }
+        seq_printf(m, "last_release_ns: %lld\n", ktime_to_ns(release_time));
+        seq_printf(m, "start_latency_ns: mean %llu min %llu max %llu jitter %llu\n",
+                   stats.started ? div64_u64(stats.latency_sum, stats.started) : 0,
+                   stats.latency_min, stats.latency_max, stats.latency_max - stats.latency_min);
+        seq_printf(m, "response_time_ns: mean %llu max %llu\n",
+                   stats.finished ? div64_u64(stats.response_sum, stats.finished) : 0, stats.response_max);
+        seq_printf(m, "exec_time_ns: mean %llu max %llu\n",
+                   stats.finished ? div64_u64(stats.exec_sum, stats.finished) : 0, stats.exec_max);
+        _seq_print_hist(m, "start_latency_hist_us", stats.latency_hist);
+        _seq_print_hist(m, "response_time_hist_us", stats.response_hist);
+        return 0;
+}
+
+// cpus_show - /proc/mp2/cpus, one line per CPU:
+// "cpu <n>: util <sum * 10000>, switches <n>, setattrs <n>, releases <n>, release_batches <n>"
+int cpus_show(struct seq_file* m, void* v) {
+        int cpu;
+
+        for_each_online_cpu(cpu) {
+                struct mp2_cpu* rq = per_cpu_ptr(&mp2_cpus, cpu);
+                seq_printf(m, "cpu %d: util %d, switches %llu, setattrs %llu, releases %llu, release_batches %llu\n",
+                           cpu, READ_ONCE(rq->util_sum), READ_ONCE(rq->switches), READ_ONCE(rq->setattrs),
+                           READ_ONCE(rq->released), READ_ONCE(rq->release_batches));
+        }
+        return 0;
+}
+
+// export_show - /proc/mp2/export, the registered task set as commands another module instance accepts, one per line:
+// "I,<pid>,<period>us,<processing time>us,<release ns>" for a periodic task and "S,<pid>,<period>us,<budget>us" for a
+// server. Pending updates are exported with their new parameters
+int export_show(struct seq_file* m, void* v) {
+        struct mp2_task_struct* task;
+
+        mutex_lock(&registry_lock);
+        list_for_each_entry(task, &registered_processes, list) {
+                struct mp2_entity admitted = _admitted_entity(task);
+                if (task->server) {
+                        seq_printf(m, "S,%d,%lluus,%lluus\n", task->pid, admitted.period, admitted.processing_time);
+                }
+                else {
+                        seq_printf(m, "I,%d,%lluus,%lluus,%lld\n", task->pid, admitted.period, admitted.processing_time,
+                                   ktime_to_ns(READ_ONCE(task->entity.release_time)));
+                }
+        }
+        mutex_unlock(&registry_lock);
+        return 0;
+}
+
+// _cmp_period - sort() comparator, shorter period first
+int _cmp_period(const void* a, const void* b) {
+        const struct mp2_entity* x = a;
+        const struct mp2_entity* y = b;
+
+        return (x->period > y->period) - (x->period < y->period);
+}
+
+// admission_control - decides whether cand fits with the tasks already on a CPU, other than self if it is not NULL
+// The utilization bound check is O(1) against the CPU's util_sum, response-time analysis is left to
+// the policy core over a snapshot of the CPU's tasks sorted by period. Under EDF the O(1) U <= 1 test is exact
+// Caller must hold registry_lock so the decision and the insertion are atomic
+int admission_control(struct mp2_cpu* rq, const struct mp2_entity* cand, struct mp2_task_struct* self) {
+        int util_sum = rq->util_sum - (self != NULL ? self->util : 0);
+        struct mp2_entity* tasks;
+        struct mp2_task_struct* tmp;
+        int n = 0;
+
+        if (sched_policy == MP2_POLICY_EDF) {
+                return mp2_admit_edf(util_sum, cand);
+        }
+        if (mp2_admit_util(util_sum, cand)) {
+                return 1;
+        }
+        if (admission_mode != ADMISSION_RTA) {
+                return 0;
+        }
+
+        // a CPU never holds more than max_tasks tasks, they all come from task_pool. A task with a pending update
+        // may release jobs with either parameters before its next release, so it interferes with both, and one
+        // a batch update admitted earlier in the same batch interferes with its new parameters as well
+        tasks = rta_scratch;
+        list_for_each_entry(tmp, &(rq->tasks), cpu_list) {
+                if (tmp != self) {
+                        tasks[n++] = tmp->entity;
+                        if (tmp->entity.next_period != 0) {
+                                tasks[n++] = _admitted_entity(tmp);
+                        }
+                        if (tmp->staged != NULL) {
+                                tasks[n++] = *(tmp->staged);
+                        }
+                }
+        }
+        sort(tasks, n, sizeof(*tasks), _cmp_period, NULL);
+        return mp2_admit_rta(tasks, n, cand);
+}
+
+// place_task - partitions a new task onto a CPU in allowed that admits it, NULL if no CPU does
+// Caller must hold registry_lock
+struct mp2_cpu* place_task(const struct mp2_entity* cand, const struct cpumask* allowed) {
+        struct mp2_cpu* best = NULL;
+        int cpu;
+
+        for_each_cpu_and(cpu, allowed, cpu_online_mask) {
+                struct mp2_cpu* rq = per_cpu_ptr(&mp2_cpus, cpu);
+
+                // a CPU that came online after the module loaded has no dispatch thread
+                if (rq->dispatch_thread == NULL || !admission_control(rq, cand, NULL)) {
+                        continue;
+                }
+                if (placement == PLACEMENT_FIRST_FIT) {
+                        return rq;
+                }
+                if (best == NULL || rq->util_sum < best->util_sum) {
+                        best = rq;
+                }
+        }
+        return best;
+}
+
+// _insert_sorted - inserts a task into its CPU's tasks after every task with a rank_period no longer than its own
+// Caller must hold registry_lock
+void _insert_sorted(struct mp2_cpu* rq, struct mp2_task_struct* task) {
+        u64 period = task->rank_period;
+        struct mp2_task_struct* tmp;
+
+        list_for_each_entry(tmp, &(rq->tasks), cpu_list) {
+                if (tmp->rank_period > period) {
+                        break;
+                }
+        }
+        // list_add_tail before tmp; when no task is longer tmp->cpu_list is the list head itself
+        list_add_tail(&(task->cpu_list), &(tmp->cpu_list));
+}
+
+// The command log is a relay channel with one file per CPU, each a plain array of struct mp2_record. A command
+// is logged on the CPU that handled it, after it returns, with the time it was received, so readers merge the
+// files by time. When the log is full new records are dropped until a reader consumes it
+
+struct dentry* record_create_buf_file(const char* filename, struct dentry* parent, umode_t mode,
+                                      struct rchan_buf* buf, int* is_global) {
+        return debugfs_create_file(filename, mode, parent, buf, &relay_file_operations);
+}
+
+int record_remove_buf_file(struct dentry* dentry) {
+        debugfs_remove(dentry);
+        return 0;
+}
+
+struct rchan_callbacks record_callbacks = {
+        .create_buf_file = record_create_buf_file,
+        .remove_buf_file = record_remove_buf_file,
+};
+
+// _record_command - logs one command and its result if record is set
+void _record_command(char op, int pid, u64 period, u64 processing_time, ktime_t received, int ret) {
+        struct mp2_record rec;
+
+        if (!READ_ONCE(record) || record_chan == NULL) {
+                return;
+        }
+        rec.time_ns = ktime_to_ns(received);
+        rec.period_us = period;
+        rec.processing_time_us = processing_time;
+        rec.pid = pid;
+        rec.ret = ret;
+        rec.op = op;
+        rec.reserved = 0;
+        relay_write(record_chan, &rec, sizeof(rec));
+}
+
+// parse_time_us - parses a duration with an optional "us" or "ms" suffix into microseconds, no suffix means milliseconds
+// Returns -EINVAL if str is malformed or the duration doesn't fit in 64 bits of microseconds
+int parse_time_us(char* str, u64* us) {
+        u64 scale = USEC_PER_MSEC;
+        u64 value;
+        size_t len;
+
+        if (str == NULL) {
+                return -EINVAL;
+        }
+        str = strim(str);
+        len = strlen(str);
+        if (len > 2 && (str[len - 2] == 'u' || str[len - 2] == 'm') && str[len - 1] == 's') {
+                scale = (str[len - 2] == 'u') ? 1 : USEC_PER_MSEC;
+                str[len - 2] = '\0';
+        }
+        if (kstrtou64(str, 10, &value) != 0 || check_mul_overflow(value, scale, us)) {
+                return -EINVAL;
+        }
+        return 0;
+}
+
+// parse_pid - parses a positive pid, -EINVAL if str is missing or malformed
+int parse_pid(char* str, int* pid) {
+        if (str == NULL || kstrtoint(strim(str), 10, pid) != 0 || *pid <= 0) {
+                return -EINVAL;
+        }
+        return 0;
+}
+
+// parse_task_args - parses "<pid>,<period>,<processing time>", -EINVAL if a field is missing or malformed
+int parse_task_args(char* str, int* pid, u64* period, u64* processing_time) {
+        if (parse_pid(strsep(&str, ","), pid) != 0 || parse_time_us(strsep(&str, ","), period) != 0 ||
+            parse_time_us(str, processing_time) != 0) {
+                return -EINVAL;
+        }
+        return 0;
+}
+
+// _alloc_task - takes a task from task_pool and initializes it, not yet placed or visible
+// Returns NULL once max_tasks tasks are registered or waiting to be freed
+struct mp2_task_struct* _alloc_task(int pid, u64 period, u64 processing_time) {
+        struct mp2_task_struct* task;
+        unsigned long flags;
+
+        spin_lock_irqsave(&task_pool_lock, flags);
+        task = list_first_entry_or_null(&task_pool, struct mp2_task_struct, list);
+        if (task != NULL) {
+                list_del(&(task->list));
+        }
+        spin_unlock_irqrestore(&task_pool_lock, flags);
+        if (task == NULL) {
+                return NULL;
+        }
+
+        // initialize task SLEEPING state, pid, period, processing time, deadline
+        task->state = SLEEPING;
+        task->pid = pid;
+        mp2_entity_init(&(task->entity), period, processing_time);
+        task->util = mp2_task_util(processing_time, period);
+        task->rank_period = period;
+        task->update_applied = false;
+        task->staged = NULL;
+        memset(&(task->stats), 0, sizeof(task->stats));
+        RB_CLEAR_NODE(&(task->ready_node));
+
+        // initialize task wakeup_timer, releases are absolute so they don't drift
+        hrtimer_init(&(task->wakeup_timer), CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        task->wakeup_timer.function = wakeup_timer_callback;
+
+        // initialize task budget_timer, pinned so it fires on the CPU the task runs on
+        hrtimer_init(&(task->budget_timer), CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
+        task->budget_timer.function = budget_timer_callback;
+        task->budget_used = 0;
+        task->run_start = 0;
+        task->overruns = 0;
+        task->rt_priority = 0;
+        task->promoted = false;
+        task->applied_priority = 0;
+        task->stats_entry = NULL;
+
+        task->server = false;
+        task->serving = false;
+        task->pending_jobs = 0;
+        task->capacity = processing_time * NSEC_PER_USEC;
+        task->activation = 0;
+        task->repl_head = 0;
+        task->repl_count = 0;
+        atomic_set(&(task->release_queued), 0);
+        init_waitqueue_head(&(task->wait));
+        task->release_signalled = true;
+        task->releases = 0;
+        task->last_release = 0;
+        task->dead = false;
+        kref_init(&(task->ref));
+
+        // initialize task task_struct, referenced so it can't be freed under the task if the process exits
+        // before it deregisters
+        rcu_read_lock();
+        task->linux_task = get_pid_task(find_vpid(pid), PIDTYPE_PID);
+        rcu_read_unlock();
+        return task;
+}
+
+// _reserve_task - places a task on a CPU that admits it and charges that CPU for it, NULL if no CPU does
+// A reserved task counts towards the admission of later tasks but can't be looked up or dispatched
+// until it is published
+// Caller must hold registry_lock
+struct mp2_cpu* _reserve_task(struct mp2_task_struct* task) {
+        // only CPUs the process may run on, e.g. within its cpuset, or pinning it would fail
+        struct mp2_cpu* rq = place_task(&(task->entity), task->linux_task->cpus_ptr);
+
+        if (rq != NULL) {
+                task->cpu = rq->cpu;
+                rq->util_sum += task->util;
+                _insert_sorted(rq, task);
+        }
+        return rq;
+}
+
+// _unreserve_task - undoes _reserve_task for a task that was never published
+// Caller must hold registry_lock
+void _unreserve_task(struct mp2_task_struct* task) {
+        struct mp2_cpu* rq = task_rq(task);
+
+        list_del(&(task->cpu_list));
+        rq->util_sum -= task->util;
+}
+
+// _pin_task - pins a reserved task's process to its CPU before its first release can dispatch it, saving
+// the affinity it had for _unpin_task. Returns 0 or the error of set_cpus_allowed_ptr
+// Caller must hold registry_lock
+int _pin_task(struct mp2_task_struct* task) {
+        cpumask_copy(task->cpus_allowed, task->linux_task->cpus_ptr);
+        return set_cpus_allowed_ptr(task->linux_task, cpumask_of(task->cpu));
+}
+
+// _unpin_task - restores the affinity a task's process had before _pin_task, unless it exited
+// Caller must hold registry_lock, this may sleep so not a CPU's lock
+void _unpin_task(struct mp2_task_struct* task) {
+        if (!_task_exited(task)) {
+                set_cpus_allowed_ptr(task->linux_task, task->cpus_allowed);
+        }
+}
+
+// _create_stats_entry - creates /proc/mp2/tasks/<pid> for a reserved task, the one allocation registration makes
+// Returns 0 or -ENOMEM, a failed registration removes the entry with proc_remove
+// Caller must hold registry_lock, which keeps a second registration of the pid from creating the same entry
+int _create_stats_entry(struct mp2_task_struct* task) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "%d", task->pid);
+        task->stats_entry = proc_create_single_data(name, 0444, tasks_dir, task_stats_show, task);
+        return task->stats_entry != NULL ? 0 : -ENOMEM;
+}
+
+// _publish_task - inserts a reserved and pinned task into the list of tasks and the pid lookup table,
+// after which it can yield and be dispatched
+// Caller must hold registry_lock and have assigned the task's priority with _assign_priorities
+void _publish_task(struct mp2_task_struct* task) {
+        list_add_tail_rcu(&(task->list), &registered_processes);
+        hash_add_rcu(pid_table, &(task->pid_node), task->pid);
+}
+
+// mp2_register - registers pid as a periodic task, or as a sporadic server with budget processing_time
+// replenished every period, if some CPU admits it. A server is admitted exactly like a periodic task
+// with the same parameters
+// Returns 0 or a negative errno (-ENOSPC once max_tasks are registered, -ESRCH for a pid without a process,
+// -EBUSY if it is already registered or doesn't fit, -ENOMEM if its stats entry can't be created), shared by
+// the proc and the ioctl interfaces
+int mp2_register(int pid, u64 period, u64 processing_time, bool server) {
+        if (!mp2_params_valid(period, processing_time)) {
+                return -EINVAL;
+        }
+
+        struct mp2_task_struct* task = _alloc_task(pid, period, processing_time);
+        if (task == NULL) {
+                return -ENOSPC;
+        }
+        task->server = server;
+
+        // placement, admission control and insertion happen under one lock so concurrent registrations can't overcommit
+        mutex_lock(&registry_lock);
+        if (stopping) {
+                mutex_unlock(&registry_lock);
+                _free_task(task);
+                return -ESHUTDOWN;
+        }
+        struct mp2_cpu* rq = NULL;
+        int ret = -EBUSY;
+        if (task->linux_task == NULL) {
+                ret = -ESRCH;
+        }
+        else if (get_mp2_struct(pid) == NULL) {
+                rq = _reserve_task(task);
+        }
+        if (rq != NULL) {
+                ret = _create_stats_entry(task);
+                if (ret == 0) {
+                        ret = _pin_task(task);
+                }
+                if (ret != 0) {
+                        // waits for readers of the stats file to finish
+                        proc_remove(task->stats_entry);
+                        _unreserve_task(task);
+                        rq = NULL;
+                }
+        }
+        if (rq != NULL) {
+                _assign_priorities(rq);
+                _publish_task(task);
+        }
+        mutex_unlock(&registry_lock);
+        trace_mp2_admit(pid, period, processing_time, rq != NULL ? rq->cpu : -1);
+
+        if (rq == NULL) {
+                // never published, no RCU reader can see it
+                _free_task(task);
+                return ret;
+        }
+        return 0;
+}
+
+// mp2_import - registers pid like mp2_register, on the release grid of the instance that exported it
+// release is any release of the task in that instance, 0 if it never yielded. The job in progress keeps
+// running under SCHED_NORMAL and ends by the first grid release at or after now, where the next job is
+// released, so a reloaded module takes the task over at its next release boundary
+// Returns what mp2_register returns, or -ESRCH if the task was deregistered before it was put on the grid
+int mp2_import(int pid, u64 period, u64 processing_time, s64 release) {
+        int ret = mp2_register(pid, period, processing_time, false);
+
+        if (ret == 0 && release != 0) {
+                rcu_read_lock();
+                struct mp2_task_struct* task = get_mp2_struct(pid);
+                if (task != NULL) {
+                        struct mp2_cpu* rq = task_rq(task);
+                        spin_lock_irq(&(rq->lock));
+                        if (task->dead) { // deregistered since it was registered
+                                ret = -ESRCH;
+                        }
+                        else if (task->entity.release_time == 0) { // unless it yielded since it was registered
+                                mp2_entity_resume(&(task->entity), release, ktime_get());
+                        }
+                        spin_unlock_irq(&(rq->lock));
+                }
+                else {
+                        ret = -ESRCH;
+                }
+                rcu_read_unlock();
+        }
+        return ret;
+}
+
+// _commit_update - applies an admitted update to a task, see mp2_update
+// Caller must hold registry_lock
+void _commit_update(struct mp2_task_struct* task, u64 period, u64 processing_time) {
+        struct mp2_cpu* rq = task_rq(task);
+        bool applied;
+        int util;
+
+        spin_lock_irq(&(rq->lock));
+        mp2_entity_update(&(task->entity), period, processing_time, task->state == SLEEPING);
+        applied = task->entity.next_period == 0;
+        util = _charged_util(task);
+        spin_unlock_irq(&(rq->lock));
+
+        rq->util_sum += util - task->util;
+        task->util = util;
+        if (applied) {
+                // re-sort by the new period and re-rank the CPU's priorities
+                list_del(&(task->cpu_list));
+                task->rank_period = period;
+                _insert_sorted(rq, task);
+                _assign_priorities(rq);
+        }
+}
+
+// mp2_update - changes the period and processing time of a registered task without deregistering it
+// Only the difference is admitted: the task is checked against the other tasks on its CPU with its new
+// parameters, and it stays on that CPU. The task switches to them at its next release. A sleeping task's
+// next job keeps its release time, so its wakeup_timer stays armed, and only its deadline moves, and its
+// CPU's utilization and priority ranks take the new parameters at once. A task in the middle of a job
+// finishes it with the old parameters: until its release the CPU charges it the larger of its old and new
+// utilization and it keeps its rank, so its priority agrees with its place in the ready queue.
+// Returns -EINVAL for invalid parameters, -ESRCH if pid isn't registered and -EBUSY if the update doesn't fit
+int mp2_update(int pid, u64 period, u64 processing_time) {
+        struct mp2_entity cand;
+        int ret = 0;
+        int cpu = -1;
+
+        if (!mp2_params_valid(period, processing_time)) {
+                return -EINVAL;
+        }
+        mp2_entity_init(&cand, period, processing_time);
+
+        mutex_lock(&registry_lock);
+        struct mp2_task_struct* task = get_mp2_struct(pid);
+        if (task == NULL) {
+                ret = -ESRCH;
+        }
+        else if (task->server) {
+                ret = -EINVAL;
+        }
+        else if (!admission_control(task_rq(task), &cand, task)) {
+                ret = -EBUSY;
+        }
+        else {
+                _commit_update(task, period, processing_time);
+                cpu = task->cpu;
+        }
+        mutex_unlock(&registry_lock);
+        trace_mp2_admit(pid, period, processing_time, cpu);
+        return ret;
+}
+
+// mp2_update_batch - updates every task in args, or none of them
+// The updates are admitted in order under a single registry_lock acquisition, each against its CPU with the
+// updates before it in the batch staged: a staged task is charged the larger of its old and new utilization
+// and interferes with both its old and new parameters, as it would once updated. Only when every update is
+// admitted are they applied, each exactly like mp2_update
+// Returns -EINVAL for a malformed or duplicated entry or a server, -ESRCH if a pid isn't registered, -EBUSY if
+// an update doesn't fit
+int mp2_update_batch(struct mp2_register_args* args, int count) {
+        struct mp2_task_struct** tasks;
+        struct mp2_entity* cands;
+        int* utils; // what each staged task was charged before it was staged
+        int staged = 0;
+        int ret = 0;
+        int i, j;
+
+        if (count <= 0 || count > MP2_BATCH_MAX) {
+                return -EINVAL;
+        }
+        for (i = 0; i < count; i++) {
+                if (args[i].pid <= 0 || !mp2_params_valid(args[i].period_us, args[i].processing_time_us)) {
+                        return -EINVAL;
+                }
+                for (j = 0; j < i; j++) {
+                        if (args[j].pid == args[i].pid) {
+                                return -EINVAL;
+                        }
+                }
+        }
+
+        tasks = kcalloc(count, sizeof(*tasks), GFP_KERNEL);
+        cands = kcalloc(count, sizeof(*cands), GFP_KERNEL);
+        utils = kcalloc(count, sizeof(*utils), GFP_KERNEL);
+        if (tasks == NULL || cands == NULL || utils == NULL) {
+                ret = -ENOMEM;
+                goto out_free;
+        }
+        for (i = 0; i < count; i++) {
+                mp2_entity_init(&(cands[i]), args[i].period_us, args[i].processing_time_us);
+        }
+
+        mutex_lock(&registry_lock);
+        for (i = 0; i < count && ret == 0; i++) {
+                tasks[i] = get_mp2_struct(args[i].pid);
+                if (tasks[i] == NULL) {
+                        ret = -ESRCH;
+                }
+                else if (tasks[i]->server) {
+                        ret = -EINVAL;
+                }
+        }
+        for (i = 0; i < count && ret == 0; i++) {
+                struct mp2_cpu* rq = task_rq(tasks[i]);
+                int util = mp2_task_util(cands[i].processing_time, cands[i].period);
+
+                if (!admission_control(rq, &(cands[i]), tasks[i])) {
+                        ret = -EBUSY;
+                        break;
+                }
+                utils[i] = tasks[i]->util;
+                util = max(util, tasks[i]->util);
+                rq->util_sum += util - tasks[i]->util;
+                tasks[i]->util = util;
+                tasks[i]->staged = &(cands[i]);
+                staged++;
+        }
+
+        // unstage, the updates then apply from the CPUs' real state
+        for (i = staged - 1; i >= 0; i--) {
+                task_rq(tasks[i])->util_sum += utils[i] - tasks[i]->util;
+                tasks[i]->util = utils[i];
+                tasks[i]->staged = NULL;
+        }
+        if (ret == 0) {
+                for (i = 0; i < count; i++) {
+                        _commit_update(tasks[i], args[i].period_us, args[i].processing_time_us);
+                }
+        }
+        mutex_unlock(&registry_lock);
+
+        for (i = 0; i < count; i++) {
+                trace_mp2_admit(args[i].pid, args[i].period_us, args[i].processing_time_us,
+                                ret == 0 ? tasks[i]->cpu : -1);
+        }
+
+out_free:
+        kfree(utils);
+        kfree(cands);
+        kfree(tasks);
+        return ret;
+}
+
+// update_work_callback - settles the tasks on a CPU whose update took effect at a release: they are charged
+// their new utilization and re-sorted and re-ranked by their new period
+void update_work_callback(struct work_struct* work) {
+        struct mp2_cpu* rq = container_of(work, struct mp2_cpu, update_work);
+        struct mp2_task_struct *tmp, *q;
+        LIST_HEAD(settled);
+
+        mutex_lock(&registry_lock);
+        list_for_each_entry_safe(tmp, q, &(rq->tasks), cpu_list) {
+                bool applied;
+                u64 period;
+                int util;
+
+                spin_lock_irq(&(rq->lock));
+                applied = tmp->update_applied;
+                tmp->update_applied = false;
+                util = _charged_util(tmp);
+                period = tmp->entity.period;
+                spin_unlock_irq(&(rq->lock));
+                if (applied) {
+                        rq->util_sum += util - tmp->util;
+                        tmp->util = util;
+                        tmp->rank_period = period;
+                        list_move_tail(&(tmp->cpu_list), &settled);
+                }
+        }
+        if (!list_empty(&settled)) {
+                list_for_each_entry_safe(tmp, q, &settled, cpu_list) {
+                        list_del(&(tmp->cpu_list));
+                        _insert_sorted(rq, tmp);
+                }
+                _assign_priorities(rq);
+        }
+        mutex_unlock(&registry_lock);
+}
+
+// _cmp_util_desc - sort() comparator, higher utilization first
+int _cmp_util_desc(const void* a, const void* b) {
+        const struct mp2_task_struct* x = *(struct mp2_task_struct* const*) a;
+        const struct mp2_task_struct* y = *(struct mp2_task_struct* const*) b;
+
+        return mp2_task_util(y->entity.processing_time, y->entity.period) -
+               mp2_task_util(x->entity.processing_time, x->entity.period);
+}
+
+// mp2_register_batch - registers every task in args, or none of them
+// The whole set is admitted under a single registry_lock acquisition. Tasks are placed in order of
+// decreasing utilization (first-fit or worst-fit decreasing), so small tasks can't fragment the CPUs
+// before the large ones are placed, and each placement is checked against the tasks reserved before it.
+// Returns -EINVAL for a malformed or duplicated entry, -ESRCH for a pid without a process, -EBUSY if
+// a pid is already registered or the set doesn't fit, -ENOMEM if the stats entries can't be created
+int mp2_register_batch(struct mp2_register_args* args, int count) {
+        struct mp2_task_struct** tasks;
+        int reserved = 0;
+        int created = 0;
+        int pinned = 0;
+        int ret = 0;
+        int i, j;
+
+        if (count <= 0 || count > MP2_BATCH_MAX) {
+                return -EINVAL;
+        }
+        for (i = 0; i < count; i++) {
+                if (args[i].pid <= 0 || !mp2_params_valid(args[i].period_us, args[i].processing_time_us)) {
+                        return -EINVAL;
+                }
+        }
+
+        tasks = kcalloc(count, sizeof(*tasks), GFP_KERNEL);
+        if (tasks == NULL) {
+                return -ENOMEM;
+        }
+        for (i = 0; i < count; i++) {
+                tasks[i] = _alloc_task(args[i].pid, args[i].period_us, args[i].processing_time_us);
+                if (tasks[i] == NULL) {
+                        ret = -ENOSPC;
+                        goto out_free;
+                }
+        }
+        sort(tasks, count, sizeof(*tasks), _cmp_util_desc, NULL);
+
+        mutex_lock(&registry_lock);
+        if (stopping) {
+                ret = -ESHUTDOWN;
+        }
+        for (i = 0; i < count && ret == 0; i++) {
+                if (tasks[i]->linux_task == NULL) {
+                        ret = -ESRCH;
+                }
+                else if (get_mp2_struct(tasks[i]->pid) != NULL) {
+                        ret = -EBUSY;
+                }
+                for (j = 0; j < i && ret == 0; j++) {
+                        if (tasks[j]->pid == tasks[i]->pid) {
+                                ret = -EINVAL;
+                        }
+                }
+        }
+        for (i = 0; i < count && ret == 0; i++) {
+                if (_reserve_task(tasks[i]) == NULL) {
+                        ret = -EBUSY;
+                }
+                else {
+                        reserved++;
+                }
+        }
+
+        for (i = 0; i < count && ret == 0; i++) {
+                ret = _create_stats_entry(tasks[i]);
+                if (ret == 0) {
+                        created++;
+                }
+        }
+
+        for (i = 0; i < count && ret == 0; i++) {
+                ret = _pin_task(tasks[i]);
+                if (ret == 0) {
+                        pinned++;
+                }
+        }
+
+        if (ret != 0) {
+                for (i = 0; i < pinned; i++) {
+                        _unpin_task(tasks[i]);
+                }
+                for (i = 0; i < created; i++) {
+                        proc_remove(tasks[i]->stats_entry);
+                }
+                for (i = 0; i < reserved; i++) {
+                        _unreserve_task(tasks[i]);
+                }
+        }
+        else {
+                int cpu;
+                for_each_online_cpu(cpu) {
+                        _assign_priorities(per_cpu_ptr(&mp2_cpus, cpu));
+                }
+                for (i = 0; i < count; i++) {
+                        _publish_task(tasks[i]);
+                }
+        }
+        mutex_unlock(&registry_lock);
+
+        for (i = 0; i < count; i++) {
+                trace_mp2_admit(tasks[i]->pid, tasks[i]->entity.period, tasks[i]->entity.processing_time,
+                                ret == 0 ? tasks[i]->cpu : -1);
+        }
+
+out_free:
+        if (ret != 0) {
+                // never published, no RCU reader can see them
+                for (i = 0; i < count && tasks[i] != NULL; i++) {
+                        _free_task(tasks[i]);
+                }
+        }
+        kfree(tasks);
+        return ret;
+}
+
+// _server_yield - ends a server's job, if one is in progress, and starts the next pending job if capacity is left
+// Returns 1 if a job starts right away, 0 if the server sleeps until a submission or a replenishment
+// Caller must hold the task's CPU lock
+int _server_yield(struct mp2_task_struct* task, ktime_t now) {
+        if (task->entity.release_time == 0) { // first yield, the server starts waiting for jobs
+                task->entity.release_time = now;
+        }
+        if (task->state == RUNNING) {
+                _stop_budget(task);
+        }
+        if (task->serving) {
+                _record_job_end(task, now);
+                task->serving = false;
+                task->entity.jobs++;
+                task->pending_jobs--;
+        }
+
+        if (task->state == THROTTLED) {
+                // exhausted, the next job starts when capacity is replenished
+                return 0;
+        }
+        if (task->pending_jobs > 0 && task->capacity > task->budget_used) {
+                if (task->activation == 0) {
+                        _server_activate(task, now);
+                }
+                else { // the busy interval goes on with the next job
+                        task->serving = true;
+                        task->entity.release_time = now;
+                        _set_task_state(task, READY);
+                        _publish_release(task);
+                }
+                return 1;
+        }
+        if (task->activation != 0) {
+                _server_end_interval(task);
+        }
+        _set_task_state(task, task->pending_jobs > 0 ? THROTTLED : SLEEPING);
+        return 0;
+}
+
+// mp2_yield - ends the current job of pid and, if block is set, waits until its next job is dispatched
+// Fills info with the next job's release time and deadline when info is not NULL
+// The wait is interruptible: a signal ends it with -EINTR, the job has ended either way and the next release
+// can still be waited for through a task fd. A non-blocking yield leaves that wait to the task fd
+// A task that returns to userspace before its next job is dispatched is demoted, it would otherwise run at its
+// SCHED_FIFO priority with no budget charged. The dispatch of its next job promotes it again
+int mp2_yield(int pid, struct mp2_job_info* info, bool block) {
+        int should_sleep = 0;
+        int should_sync = 0;
+        struct mp2_cpu* rq = NULL;
+
+        // find yielding task, the lookup doesn't take any lock
+        rcu_read_lock();
+        struct mp2_task_struct* yielding_task = get_mp2_struct(pid);
+
+        if (yielding_task != NULL) {
+                ktime_t now = ktime_get();
+                rq = task_rq(yielding_task);
+
+                spin_lock_irq(&(rq->lock));
+                // deregistered since the lookup: its timers are cancelled and it must not be queued again
+                if (yielding_task->dead) {
+                        spin_unlock_irq(&(rq->lock));
+                        yielding_task = NULL;
+                        goto out;
+                }
+                int released;
+                if (yielding_task->server) {
+                        released = _server_yield(yielding_task, now);
+                }
+                else {
+                        if (yielding_task->entity.release_time != 0) { // a job ends, unless the process just registered
+                                if (yielding_task->state == RUNNING) {
+                                        _stop_budget(yielding_task);
+                                }
+                                yielding_task->budget_used = 0;
+                                _record_job_end(yielding_task, now);
+                        }
+                        // off the ready queue while the deadline it may be ordered by changes
+                        _set_task_state(yielding_task, SLEEPING);
+                        bool pending = yielding_task->entity.next_period != 0;
+                        released = mp2_entity_yield(&(yielding_task->entity), now);
+                        if (pending) {
+                                _update_applied(yielding_task);
+                        }
+                        if (released) {
+                                // next period has already started
+                                _set_task_state(yielding_task, READY);
+                                _publish_release(yielding_task);
+                        }
+                        else {
+                                // set wakeup timer for the next release
+                                hrtimer_start(&(yielding_task->wakeup_timer), yielding_task->entity.release_time, HRTIMER_MODE_ABS);
+                        }
+                }
+                trace_mp2_yield(pid, yielding_task->cpu, yielding_task->entity.jobs, yielding_task->entity.release_time,
+                                yielding_task->entity.deadline, released);
+                if (info != NULL) {
+                        info->release_ns = ktime_to_ns(yielding_task->entity.release_time);
+                        info->deadline_ns = ktime_to_ns(yielding_task->entity.deadline);
+                }
+
+                if (released) {
+                        spin_unlock_irq(&(rq->lock));
+                        wake_up_process(rq->dispatch_thread);
+                }
+                else {
+                        if (rq->current_mp2_task == yielding_task) {
+                                rq->current_mp2_task = NULL;
+                        }
+                        if (!block) {
+                                _demote(yielding_task);
+                        }
+                        spin_unlock_irq(&(rq->lock));
+
+                        // wakeup this CPU's dispatch thread
+                        wake_up_process(rq->dispatch_thread);
+                        // the task must outlive the wait, or its demotion, even if it is deregistered meanwhile
+                        if (kref_get_unless_zero(&(yielding_task->ref))) {
+                                should_sleep = block;
+                                should_sync = !block;
+                        }
+                }
+        }
+out:
+        rcu_read_unlock();
+
+        if (should_sync) {
+                _sync_sched(yielding_task);
+                kref_put(&(yielding_task->ref), mp2_task_release);
+        }
+
+        if (should_sleep) {
+                // sleep interruptibly until the dispatcher runs the task's next job, or it is deregistered
+                int interrupted = wait_event_interruptible(yielding_task->wait,
+                                                           READ_ONCE(yielding_task->state) == RUNNING ||
+                                                           READ_ONCE(yielding_task->dead));
+                // no job was released for a task deregistered meanwhile, e.g. by an unloading module
+                bool dead = READ_ONCE(yielding_task->dead);
+                if (interrupted) {
+                        // back to userspace without its next job, unless it was dispatched since the signal
+                        spin_lock_irq(&(rq->lock));
+                        if (yielding_task->state != RUNNING) {
+                                _demote(yielding_task);
+                        }
+                        spin_unlock_irq(&(rq->lock));
+                        _sync_sched(yielding_task);
+                }
+                kref_put(&(yielding_task->ref), mp2_task_release);
+                if (interrupted) {
+                        return -EINTR;
+                }
+                if (dead) {
+                        return -ESRCH;
+                }
+        }
+        return yielding_task != NULL ? 0 : -ESRCH;
+}
+
+// mp2_submit - submits an aperiodic job to the sporadic server pid
+// Returns -ESRCH if pid isn't registered and -EINVAL if it isn't a server
+int mp2_submit(int pid) {
+        struct mp2_cpu* rq = NULL;
+        int activated = 0;
+        int ret = 0;
+
+        rcu_read_lock();
+        struct mp2_task_struct* task = get_mp2_struct(pid);
+        if (task == NULL) {
+                ret = -ESRCH;
+        }
+        else if (!task->server) {
+                ret = -EINVAL;
+        }
+        else {
+                rq = task_rq(task);
+                spin_lock_irq(&(rq->lock));
+                if (task->dead) { // deregistered since the lookup, its timers are cancelled
+                        spin_unlock_irq(&(rq->lock));
+                        rcu_read_unlock();
+                        return -ESRCH;
+                }
+                task->pending_jobs++;
+                // a server waiting for work starts a busy interval, an exhausted one waits for a replenishment, and
+                // a busy one (or one that hasn't yielded yet) picks the job up when it yields
+                if (task->state == SLEEPING && task->entity.release_time != 0) {
+                        if (task->capacity > 0) {
+                                _server_activate(task, ktime_get());
+                                activated = 1;
+                        }
+                        else {
+                                _set_task_state(task, THROTTLED);
+                        }
+                }
+                spin_unlock_irq(&(rq->lock));
+        }
+        rcu_read_unlock();
+
+        if (activated) {
+                wake_up_process(rq->dispatch_thread);
+        }
+        return ret;
+}
+
+// _deregister - removes pid from the scheduler
+// Only a task whose process exited is removed if exited_only is set, so a pid reused since can't be hit
+int _deregister(int pid, bool exited_only) {
+        int was_current = 0;
+        struct mp2_cpu* rq = NULL;
+
+        mutex_lock(&registry_lock);
+        struct mp2_task_struct* temp_task = get_mp2_struct(pid);
+        if (temp_task != NULL && exited_only && !_task_exited(temp_task)) {
+                temp_task = NULL;
+        }
+        if (temp_task != NULL) {
+                rq = task_rq(temp_task);
+
+                // unlink from the list, pid table and its CPU, RCU readers may still see it
+                list_del_rcu(&(temp_task->list));
+                hash_del_rcu(&(temp_task->pid_node));
+                list_del(&(temp_task->cpu_list));
+                rq->util_sum -= temp_task->util;
+
+                // waits for readers of the stats file to finish
+                proc_remove(temp_task->stats_entry);
+
+                spin_lock_irq(&(rq->lock));
+                _ready_queue_remove(rq, temp_task);
+                _demote(temp_task);
+                // blocked yielders and fd readers return
+                WRITE_ONCE(temp_task->dead, true);
+                wake_up_interruptible(&(temp_task->wait));
+                if (rq->current_mp2_task == temp_task) {
+                        rq->current_mp2_task = NULL;
+                        was_current = 1;
+                }
+                spin_unlock_irq(&(rq->lock));
+                // back to SCHED_NORMAL and undo the pinning, these may sleep so they can't happen under the CPU's lock
+                _sync_sched(temp_task);
+                _unpin_task(temp_task);
+                _assign_priorities(rq);
+                trace_mp2_deregister(pid, temp_task->cpu, temp_task->entity.jobs, temp_task->entity.missed);
+        }
+        mutex_unlock(&registry_lock);
+
+        if (temp_task != NULL) {
+                // the timer must not fire after the task is freed
+                hrtimer_cancel(&(temp_task->wakeup_timer));
+                hrtimer_cancel(&(temp_task->budget_timer));
+                // nor be left on its CPU's release list, the drain skips it since it is no longer hashed
+                spin_lock_irq(&(rq->lock));
+                _drain_releases(rq);
+                spin_unlock_irq(&(rq->lock));
+                kref_put(&(temp_task->ref), mp2_task_release);
+        }
+        if (was_current) {
+                wake_up_process(rq->dispatch_thread);
+        }
+        return temp_task != NULL ? 0 : -ESRCH;
+}
+
+// mp2_deregister - removes pid from the scheduler
+int mp2_deregister(int pid) {
+        return _deregister(pid, false);
+}
+
+// exit_work_callback - deregisters the tasks on a CPU whose process exited without deregistering
+// _deregister takes registry_lock itself, so tasks are picked one at a time
+void exit_work_callback(struct work_struct* work) {
+        struct mp2_cpu* rq = container_of(work, struct mp2_cpu, exit_work);
+
+        for (;;) {
+                struct mp2_task_struct* tmp;
+                int pid = 0;
+
+                mutex_lock(&registry_lock);
+                list_for_each_entry(tmp, &(rq->tasks), cpu_list) {
+                        if (_task_exited(tmp)) {
+                                pid = tmp->pid;
+                                break;
+                        }
+                }
+                mutex_unlock(&registry_lock);
+                if (pid == 0) {
+                        break;
+                }
+                _deregister(pid, true);
+        }
+}
+
+// proc_write_callback - parses one command. Commands other than 'B' are at most MP2_CMD_MAX bytes and are
+// parsed from a stack buffer, so the hot path ('Y') never allocates. Malformed commands fail with -EINVAL
+ssize_t proc_write_callback(struct file* file, const char __user *buf, size_t size, loff_t* pos) {
+        char cmd[MP2_CMD_MAX];
+        char* batch = NULL;
+        char* temp = cmd;
+        char operation;
+        int ret;
+        int pid = 0;
+        u64 period = 0;
+        u64 processing_time = 0;
+        ktime_t received = ktime_get();
+
+        if (*pos != 0) {
+                return 0; // CHECK: that this is correct?
+        }
+        if (size < 3) { // "<operation>,<argument>"
+                return -EINVAL;
+        }
+        if (get_user(operation, buf)) {
+                return -EFAULT;
+        }
+
+        if (operation == 'B' || operation == 'V') {
+                // a batch is bounded by MP2_BATCH_MAX tasks instead, it isn't on the hot path
+                if (size > MP2_BATCH_MAX * MP2_CMD_MAX) {
+                        return -EINVAL;
+                }
+                batch = memdup_user_nul(buf, size);
+                if (IS_ERR(batch)) {
+                        return PTR_ERR(batch);
+                }
+                temp = batch;
+        }
+        else {
+                if (size >= MP2_CMD_MAX) {
+                        return -EINVAL;
+                }
+                if (copy_from_user(cmd, buf, size)) {
+                        return -EFAULT;
+                }
+                cmd[size] = '\0';
+        }
+        if (temp[1] != ',') {
+                ret = -EINVAL;
+                goto out;
+        }
+        temp = temp + 2; // remove the first comma
+
+        if (operation == 'R' || operation == 'S') { // R,<pid>,<period>,<processing time> or S,<pid>,<period>,<budget>
+                ret = parse_task_args(temp, &pid, &period, &processing_time);
+                if (ret == 0) {
+                        ret = mp2_register(pid, period, processing_time, operation == 'S');
+                }
+        }
+        else if (operation == 'I') { // I,<pid>,<period>,<processing time>,<release ns>
+                char* release_str = strrchr(temp, ',');
+                s64 release = 0;
+
+                ret = -EINVAL;
+                if (release_str != NULL) {
+                        *release_str++ = '\0';
+                        if (kstrtos64(strim(release_str), 10, &release) == 0 && release >= 0) {
+                                ret = parse_task_args(temp, &pid, &period, &processing_time);
+                        }
+                }
+                if (ret == 0) {
+                        ret = mp2_import(pid, period, processing_time, release);
+                }
+        }
+        else if (operation == 'A') { // A,<server pid>
+                ret = parse_pid(temp, &pid);
+                if (ret == 0) {
+                        ret = mp2_submit(pid);
+                }
+        }
+        else if (operation == 'Y') { // Y,<pid>
+                ret = parse_pid(temp, &pid);
+                if (ret == 0) {
+                        ret = mp2_yield(pid, NULL, true);
+                }
+        }
+        else if (operation == 'U') { // U,<pid>,<period>,<processing time>
+                ret = parse_task_args(temp, &pid, &period, &processing_time);
+                if (ret == 0) {
+                        ret = mp2_update(pid, period, processing_time);
+                }
+        }
+        else if (operation == 'B' || operation == 'V') { // B (register) or V (update),<pid>,<period>,<processing time>;...
+                struct mp2_register_args* args;
+                int count = 1;
+                int i;
+                char* c;
+
+                for (c = temp; *c != '\0'; c++) {
+                        count += (*c == ';');
+                }
+                if (count > MP2_BATCH_MAX) {
+                        ret = -EINVAL;
+                        goto out;
+                }
+                args = kcalloc(count, sizeof(*args), GFP_KERNEL);
+                if (args == NULL) {
+                        ret = -ENOMEM;
+                        goto out;
+                }
+                ret = 0;
+                for (i = 0; i < count && ret == 0; i++) {
+                        ret = parse_task_args(strsep(&temp, ";"), &pid, &(args[i].period_us), &(args[i].processing_time_us));
+                        args[i].pid = pid;
+                }
+                if (ret == 0) {
+                        ret = operation == 'B' ? mp2_register_batch(args, count) : mp2_update_batch(args, count);
+                        for (i = 0; i < count; i++) {
+                                _record_command(operation, args[i].pid, args[i].period_us, args[i].processing_time_us, received, ret);
+                        }
+                }
+                kfree(args);
+                pid = 0; // recorded per task
+        }
+        else if (operation == 'D') { // D,<pid>
+                ret = parse_pid(temp, &pid);
+                if (ret == 0) {
+                        ret = mp2_deregister(pid);
+                }
+        }
+        else {
+                ret = -EINVAL;
+        }
+        if (pid > 0) {
+                _record_command(operation, pid, period, processing_time, received, ret);
+        }
+out:
+        kfree(batch);
+        return ret < 0 ? ret : size;
+}
+
+// A task fd is an anon inode bound to one registered task. It is readable once per job, from the job's first
+// dispatch on, and read() returns a struct mp2_release_event for the latest job it hasn't returned yet, so a task
+// can wait for its next job together with its own I/O in poll or epoll. After deregistration it reports EOF and POLLHUP
+
+// mp2_task_file - an open task fd, seen is the number of the last job it returned
+struct mp2_task_file {
+        struct mp2_task_struct* task;
+        u64 seen;
+};
+
+ssize_t task_fd_read(struct file* file, char __user *buf, size_t size, loff_t* pos) {
+        struct mp2_task_file* tf = file->private_data;
+        struct mp2_task_struct* task = tf->task;
+        struct mp2_cpu* rq = task_rq(task);
+        struct mp2_release_event event;
+        bool dead;
+
+        if (size < sizeof(event)) {
+                return -EINVAL;
+        }
+        if (!(file->f_flags & O_NONBLOCK)) {
+                int ret = wait_event_interruptible(task->wait, READ_ONCE(task->releases) != READ_ONCE(tf->seen) ||
+                                                               READ_ONCE(task->dead));
+                if (ret) {
+                        return ret;
+                }
+        }
+
+        spin_lock_irq(&(rq->lock));
+        dead = task->dead;
+        event.job = task->releases;
+        event.release_ns = ktime_to_ns(task->last_release);
+        if (event.job != tf->seen) {
+                WRITE_ONCE(tf->seen, event.job);
+        }
+        else {
+                event.job = 0;
+        }
+        spin_unlock_irq(&(rq->lock));
+
+        if (event.job == 0) {
+                return dead ? 0 : -EAGAIN;
+        }
+        if (copy_to_user(buf, &event, sizeof(event))) {
+                return -EFAULT;
+        }
+        return sizeof(event);
+}
+
+__poll_t task_fd_poll(struct file* file, poll_table* wait) {
+        struct mp2_task_file* tf = file->private_data;
+        struct mp2_task_struct* task = tf->task;
+        __poll_t mask = 0;
+
+        poll_wait(file, &(task->wait), wait);
+        if (READ_ONCE(task->releases) != READ_ONCE(tf->seen)) {
+                mask |= EPOLLIN | EPOLLRDNORM;
+        }
+        if (READ_ONCE(task->dead)) {
+                mask |= EPOLLHUP;
+        }
+        return mask;
+}
+
+int task_fd_release(struct inode* inode, struct file* file) {
+        struct mp2_task_file* tf = file->private_data;
+
+        kref_put(&(tf->task->ref), mp2_task_release);
+        kfree(tf);
+        return 0;
+}
+
+const struct file_operations mp2_task_fops = {
+        .owner = THIS_MODULE,
+        .read = task_fd_read,
+        .poll = task_fd_poll,
+        .release = task_fd_release,
+        .llseek = noop_llseek,
+};
+
+// mp2_task_fd - opens a task fd for pid, it reports the releases that happen after it is opened
+// Returns the fd or a negative errno
+int mp2_task_fd(int pid) {
+        struct mp2_task_file* tf = kmalloc(sizeof(*tf), GFP_KERNEL);
+        struct mp2_task_struct* task;
+        int fd;
+
+        if (tf == NULL) {
+                return -ENOMEM;
+        }
+        rcu_read_lock();
+        task = get_mp2_struct(pid);
+        if (task != NULL && !kref_get_unless_zero(&(task->ref))) {
+                task = NULL;
+        }
+        rcu_read_unlock();
+        if (task == NULL) {
+                kfree(tf);
+                return -ESRCH;
+        }
+
+        tf->task = task;
+        spin_lock_irq(&(task_rq(task)->lock));
+        tf->seen = task->releases;
+        spin_unlock_irq(&(task_rq(task)->lock));
+
+        fd = anon_inode_getfd("[mp2_task]", &mp2_task_fops, tf, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+                kref_put(&(task->ref), mp2_task_release);
+                kfree(tf);
+        }
+        return fd;
+}
+
+// mp2_dev_ioctl - binary fast path, the same commands as /proc/mp2/status without formatting or parsing
+// YIELD and DEREGISTER act on the calling process
+long mp2_dev_ioctl(struct file* file, unsigned int cmd, unsigned long arg) {
+        int pid = task_tgid_vnr(current);
+        ktime_t received = ktime_get();
+        int ret;
+
+        switch (cmd) {
+        case MP2_IOC_REGISTER:
+        case MP2_IOC_REGISTER_SERVER: {
+                struct mp2_register_args args;
+                if (copy_from_user(&args, (void __user *) arg, sizeof(args))) {
+                        return -EFAULT;
+                }
+                if (args.pid == 0) {
+                        args.pid = pid;
+                }
+                ret = mp2_register(args.pid, args.period_us, args.processing_time_us, cmd == MP2_IOC_REGISTER_SERVER);
+                _record_command(cmd == MP2_IOC_REGISTER ? 'R' : 'S', args.pid, args.period_us, args.processing_time_us,
+                                received, ret);
+                return ret;
+        }
+        case MP2_IOC_SUBMIT:
+                ret = mp2_submit((int) arg);
+                _record_command('A', (int) arg, 0, 0, received, ret);
+                return ret;
+        case MP2_IOC_YIELD:
+        case MP2_IOC_YIELD_NB: {
+                struct mp2_job_info info;
+                ret = mp2_yield(pid, &info, cmd == MP2_IOC_YIELD);
+                _record_command(cmd == MP2_IOC_YIELD ? 'Y' : 'N', pid, 0, 0, received, ret);
+                if (ret == 0 && arg != 0 && copy_to_user((void __user *) arg, &info, sizeof(info))) {
+                        return -EFAULT;
+                }
+                return ret;
+        }
+        case MP2_IOC_DEREGISTER:
+                ret = mp2_deregister(pid);
+                _record_command('D', pid, 0, 0, received, ret);
+                return ret;
+        case MP2_IOC_TASK_FD:
+                return mp2_task_fd(arg != 0 ? (int) arg : pid);
+        case MP2_IOC_UPDATE: {
+                struct mp2_register_args args;
+                if (copy_from_user(&args, (void __user *) arg, sizeof(args))) {
+                        return -EFAULT;
+                }
+                if (args.pid == 0) {
+                        args.pid = pid;
+                }
+                ret = mp2_update(args.pid, args.period_us, args.processing_time_us);
+                _record_command('U', args.pid, args.period_us, args.processing_time_us, received, ret);
+                return ret;
+        }
+        case MP2_IOC_REGISTER_BATCH:
+        case MP2_IOC_UPDATE_BATCH: {
+                char op = cmd == MP2_IOC_REGISTER_BATCH ? 'B' : 'V';
+                struct mp2_batch_args batch;
+                struct mp2_register_args* args;
+                int i;
+                if (copy_from_user(&batch, (void __user *) arg, sizeof(batch))) {
+                        return -EFAULT;
+                }
+                if (batch.count == 0 || batch.count > MP2_BATCH_MAX) {
+                        return -EINVAL;
+                }
+                args = memdup_user(u64_to_user_ptr(batch.tasks), batch.count * sizeof(*args));
+                if (IS_ERR(args)) {
+                        return PTR_ERR(args);
+                }
+                for (i = 0; i < batch.count; i++) {
+                        if (args[i].pid == 0) {
+                                args[i].pid = pid;
+                        }
+                }
+                ret = op == 'B' ? mp2_register_batch(args, batch.count) : mp2_update_batch(args, batch.count);
+                for (i = 0; i < batch.count; i++) {
+                        _record_command(op, args[i].pid, args[i].period_us, args[i].processing_time_us, received, ret);
+                }
+                kfree(args);
+                return ret;
+        }
+        }
+        return -ENOTTY;
+}
+
+const struct proc_ops proc_fops = {
+   .proc_open = proc_open_callback,
+   .proc_read = seq_read,
+   .proc_lseek = seq_lseek,
+   .proc_release = seq_release,
+   .proc_write = proc_write_callback,
+};
+
+struct proc_dir_entry* proc_dir;
+struct proc_dir_entry* proc_file;
+
+// The fops own the module, so an open /dev/mp2 or task fd keeps it loaded: rmmod fails with EBUSY until they are
+// closed, instead of mp2_exit waiting on processes it can't make close them
+const struct file_operations mp2_dev_fops = {
+        .owner = THIS_MODULE,
+        .unlocked_ioctl = mp2_dev_ioctl,
+        .compat_ioctl = compat_ptr_ioctl,
+};
+
+struct miscdevice mp2_dev = {
+        .minor = MISC_DYNAMIC_MINOR,
+        .name = MP2_DEVICE_NAME,
+        .fops = &mp2_dev_fops,
+        .mode = 0666,
+};
+
+// _destroy_task_pool - frees every pooled task, the cache they came from and the admission scratch space
+void _destroy_task_pool(void) {
+        struct mp2_task_struct *task, *q;
+
+        kvfree(rta_scratch);
+        list_for_each_entry_safe(task, q, &task_pool, list) {
+                list_del(&(task->list));
+                free_cpumask_var(task->cpus_allowed);
+                kmem_cache_free(mp2_cache, task);
+        }
+        kmem_cache_destroy(mp2_cache);
+}
+
+// _stop_dispatchers - stops the dispatch threads that were started
+void _stop_dispatchers(void) {
+        int cpu;
+
+        for_each_possible_cpu(cpu) {
+                struct mp2_cpu* rq = per_cpu_ptr(&mp2_cpus, cpu);
+                if (rq->dispatch_thread != NULL) {
+                        kthread_stop(rq->dispatch_thread);
+                        rq->dispatch_thread = NULL;
+                }
+        }
+}
+
+// mp2_init - Called when module is loaded
+// The task pool and the dispatch threads exist before the interfaces do, so no command finds them missing
+int __init mp2_init(void)
+{
+        #ifdef DEBUG
+        printk(KERN_ALERT "MP2(): MODULE LOADING\n");
+        #endif
+        int cpu;
+        int i;
+        int ret;
+
+        // create new cache of size sizeof(mp2_task_struct) and fill the task pool from it
+        mp2_cache = KMEM_CACHE(mp2_task_struct, SLAB_PANIC);
+        if (max_tasks <= 0) {
+                kmem_cache_destroy(mp2_cache);
+                return -EINVAL;
+        }
+        rta_scratch = kvmalloc_array(3 * max_tasks, sizeof(*rta_scratch), GFP_KERNEL);
+        if (rta_scratch == NULL) {
+                _destroy_task_pool();
+                return -ENOMEM;
+        }
+        for (i = 0; i < max_tasks; i++) {
+                struct mp2_task_struct* task = kmem_cache_alloc(mp2_cache, GFP_KERNEL);
+                if (task == NULL) {
+                        _destroy_task_pool();
+                        return -ENOMEM;
+                }
+                if (!alloc_cpumask_var(&(task->cpus_allowed), GFP_KERNEL)) {
+                        kmem_cache_free(mp2_cache, task);
+                        _destroy_task_pool();
+                        return -ENOMEM;
+                }
+                list_add(&(task->list), &task_pool);
+        }
+
+        // one ready queue and lock per CPU, initialized for every possible CPU so that a CPU brought online later
+        // is still safe to walk with for_each_online_cpu
+        for_each_possible_cpu(cpu) {
+                struct mp2_cpu* rq = per_cpu_ptr(&mp2_cpus, cpu);
+
+                spin_lock_init(&(rq->lock));
+                mutex_init(&(rq->sched_lock));
+                rq->ready_queue = RB_ROOT_CACHED;
+                rq->current_mp2_task = NULL;
+                INIT_LIST_HEAD(&(rq->tasks));
+                rq->util_sum = 0;
+                rq->cpu = cpu;
+
+                init_llist_head(&(rq->releases));
+                rq->switches = 0;
+                rq->setattrs = 0;
+                rq->released = 0;
+                rq->release_batches = 0;
+                rq->dispatch_thread = NULL;
+                INIT_WORK(&(rq->update_work), update_work_callback);
+                INIT_WORK(&(rq->exit_work), exit_work_callback);
+        }
+
+        // a dispatch thread bound to each CPU online now, place_task skips CPUs that have none
+        for_each_online_cpu(cpu) {
+                struct mp2_cpu* rq = per_cpu_ptr(&mp2_cpus, cpu);
+                struct task_struct* thread;
+
+                thread = kthread_create(&dispatch_callback, rq, "mp2_dispatch/%d", cpu);
+                if (IS_ERR(thread)) {
+                        ret = PTR_ERR(thread);
+                        goto out_stop;
+                }
+                rq->dispatch_thread = thread;
+                kthread_bind(rq->dispatch_thread, cpu);
+                // above every scheduled task, otherwise a running task would keep releases from being dispatched
+                _set_sched(rq->dispatch_thread, SCHED_FIFO, MP2_DISPATCH_PRIO);
+                // a created kthread doesn't run until it is woken once
+                wake_up_process(rq->dispatch_thread);
+        }
+
+        ret = -ENOMEM;
+        proc_dir = proc_mkdir("mp2", NULL);
+        if (proc_dir == NULL) {
+                goto out_stop;
+        }
+        proc_file = proc_create("status", 0666, proc_dir, &proc_fops);
+        tasks_dir = proc_mkdir("tasks", proc_dir);
+        if (proc_file == NULL || tasks_dir == NULL ||
+            proc_create_single("cpus", 0444, proc_dir, cpus_show) == NULL ||
+            proc_create_single("export", 0444, proc_dir, export_show) == NULL) {
+                goto out_remove_proc;
+        }
+        ret = misc_register(&mp2_dev);
+        if (ret != 0) {
+                goto out_remove_proc;
+        }
+
+        // the command log is optional, the module works without debugfs
+        BUILD_BUG_ON(MP2_RECORD_SUBBUF_SIZE % sizeof(struct mp2_record) != 0);
+        debug_dir = debugfs_create_dir("mp2", NULL);
+        if (!IS_ERR(debug_dir)) {
+                record_chan = relay_open("commands", debug_dir, MP2_RECORD_SUBBUF_SIZE, MP2_RECORD_SUBBUFS,
+                                         &record_callbacks, NULL);
+        }
+
+        printk(KERN_ALERT "MP2(): MODULE LOADED\n");
+        return 0;
+
+out_remove_proc:
+        proc_remove(proc_dir);
+out_stop:
+        _stop_dispatchers();
+        _destroy_task_pool();
+        return ret;
+}
+
+// mp2_exit - Called when module is unloaded
+// Shutdown is ordered so nothing runs against freed state. Registrations are refused first. Then every task
+// is deregistered: its timers are cancelled, its queued release is drained, it is restored to SCHED_NORMAL and
+// a yield blocked on it returns. Then the interfaces are removed, waiting for commands in flight, the dispatch
+// threads are stopped and, once RCU has released every task to the pool, the pool is freed
+void __exit mp2_exit(void)
+{
+        #ifdef DEBUG
+        printk(KERN_ALERT "MP2(): MODULE UNLOADING\n");
+        #endif
+        int cpu;
+
+        mutex_lock(&registry_lock);
+        stopping = true;
+        mutex_unlock(&registry_lock);
+
+        // mp2_deregister takes registry_lock itself, so tasks are picked one at a time
+        for (;;) {
+                struct mp2_task_struct* task;
+                int pid = 0;
+
+                mutex_lock(&registry_lock);
+                task = list_first_entry_or_null(&registered_processes, struct mp2_task_struct, list);
+                if (task != NULL) {
+                        pid = task->pid;
+                }
+                mutex_unlock(&registry_lock);
+                if (pid == 0) {
+                        break;
+                }
+                mp2_deregister(pid);
+        }
+        // no release can apply an update or drop an exited task anymore, but work queued before may still be pending
+        for_each_possible_cpu(cpu) {
+                cancel_work_sync(&(per_cpu_ptr(&mp2_cpus, cpu)->update_work));
+                cancel_work_sync(&(per_cpu_ptr(&mp2_cpus, cpu)->exit_work));
+        }
+
+        misc_deregister(&mp2_dev);
+        remove_proc_entry("status", proc_dir);
+        remove_proc_entry("export", proc_dir);
+        remove_proc_entry("cpus", proc_dir);
+        remove_proc_entry("tasks", proc_dir);
+        remove_proc_entry("mp2", NULL);
+        if (record_chan != NULL) {
+                relay_close(record_chan);
+        }
+        debugfs_remove_recursive(debug_dir);
+
+        _stop_dispatchers();
+
+        // wait for deregistered tasks to be returned to the pool
+        rcu_barrier();
+        _destroy_task_pool();
+
+        printk(KERN_ALERT "MP2(): MODULE UNLOADED\n");
+}
+
+// Register init and exit funtions
+module_init(mp2_init);
+module_exit(mp2_exit);
@@ -0,0 +1,173 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mp2
+
+#if !defined(__MP2_TRACE_INCLUDE__) || defined(TRACE_HEADER_MULTI_READ)
+#define __MP2_TRACE_INCLUDE__
+
+// Tracepoints on the release, dispatch, yield and registration paths
+// They are static keys, a disabled event costs a no-op branch. Enable with e.g.
+//   trace-cmd record -e mp2 -e sched:sched_switch
+// Times are CLOCK_MONOTONIC nanoseconds, the event timestamp itself comes from the trace clock
+
+#include <linux/tracepoint.h>
+
+// mp2_release - a job is released by its wakeup timer, replenished if it was throttled in its previous period
+TRACE_EVENT(mp2_release,
+        TP_PROTO(int pid, int cpu, u64 period, s64 release_time, s64 deadline, bool replenished),
+        TP_ARGS(pid, cpu, period, release_time, deadline, replenished),
+        TP_STRUCT__entry(
+                __field(int, pid)
+                __field(int, cpu)
+                __field(u64, period)
+                __field(s64, release_time)
+                __field(s64, deadline)
+                __field(bool, replenished)
+        ),
+        TP_fast_assign(
+                __entry->pid = pid;
+                __entry->cpu = cpu;
+                __entry->period = period;
+                __entry->release_time = release_time;
+                __entry->deadline = deadline;
+                __entry->replenished = replenished;
+        ),
+        TP_printk("pid=%d cpu=%d period_us=%llu release=%lld deadline=%lld replenished=%d",
+                  __entry->pid, __entry->cpu, __entry->period, __entry->release_time, __entry->deadline,
+                  __entry->replenished)
+);
+
+// mp2_dispatch - a dispatch thread pass, next_pid is -1 when no task is READY
+TRACE_EVENT(mp2_dispatch,
+        TP_PROTO(int cpu, int current_pid, int next_pid, s64 next_deadline),
+        TP_ARGS(cpu, current_pid, next_pid, next_deadline),
+        TP_STRUCT__entry(
+                __field(int, cpu)
+                __field(int, current_pid)
+                __field(int, next_pid)
+                __field(s64, next_deadline)
+        ),
+        TP_fast_assign(
+                __entry->cpu = cpu;
+                __entry->current_pid = current_pid;
+                __entry->next_pid = next_pid;
+                __entry->next_deadline = next_deadline;
+        ),
+        TP_printk("cpu=%d current_pid=%d next_pid=%d next_deadline=%lld",
+                  __entry->cpu, __entry->current_pid, __entry->next_pid, __entry->next_deadline)
+);
+
+// mp2_switch - the dispatcher changes the running task, prev_pid is -1 when the CPU had none
+TRACE_EVENT(mp2_switch,
+        TP_PROTO(int cpu, int prev_pid, int next_pid, u64 next_period, s64 next_deadline),
+        TP_ARGS(cpu, prev_pid, next_pid, next_period, next_deadline),
+        TP_STRUCT__entry(
+                __field(int, cpu)
+                __field(int, prev_pid)
+                __field(int, next_pid)
+                __field(u64, next_period)
+                __field(s64, next_deadline)
+        ),
+        TP_fast_assign(
+                __entry->cpu = cpu;
+                __entry->prev_pid = prev_pid;
+                __entry->next_pid = next_pid;
+                __entry->next_period = next_period;
+                __entry->next_deadline = next_deadline;
+        ),
+        TP_printk("cpu=%d prev_pid=%d next_pid=%d next_period_us=%llu next_deadline=%lld",
+                  __entry->cpu, __entry->prev_pid, __entry->next_pid, __entry->next_period, __entry->next_deadline)
+);
+
+// mp2_yield - a task ends its job, released is whether its next job is already released
+TRACE_EVENT(mp2_yield,
+        TP_PROTO(int pid, int cpu, u64 jobs, s64 release_time, s64 deadline, bool released),
+        TP_ARGS(pid, cpu, jobs, release_time, deadline, released),
+        TP_STRUCT__entry(
+                __field(int, pid)
+                __field(int, cpu)
+                __field(u64, jobs)
+                __field(s64, release_time)
+                __field(s64, deadline)
+                __field(bool, released)
+        ),
+        TP_fast_assign(
+                __entry->pid = pid;
+                __entry->cpu = cpu;
+                __entry->jobs = jobs;
+                __entry->release_time = release_time;
+                __entry->deadline = deadline;
+                __entry->released = released;
+        ),
+        TP_printk("pid=%d cpu=%d jobs=%llu next_release=%lld next_deadline=%lld released=%d",
+                  __entry->pid, __entry->cpu, __entry->jobs, __entry->release_time, __entry->deadline,
+                  __entry->released)
+);
+
+// mp2_throttle - a running job exhausted its processing time
+TRACE_EVENT(mp2_throttle,
+        TP_PROTO(int pid, int cpu, u64 budget_used, s64 deadline),
+        TP_ARGS(pid, cpu, budget_used, deadline),
+        TP_STRUCT__entry(
+                __field(int, pid)
+                __field(int, cpu)
+                __field(u64, budget_used)
+                __field(s64, deadline)
+        ),
+        TP_fast_assign(
+                __entry->pid = pid;
+                __entry->cpu = cpu;
+                __entry->budget_used = budget_used;
+                __entry->deadline = deadline;
+        ),
+        TP_printk("pid=%d cpu=%d budget_used_ns=%llu replenish_at=%lld",
+                  __entry->pid, __entry->cpu, __entry->budget_used, __entry->deadline)
+);
+
+// mp2_admit - an admission decision, cpu is -1 when no CPU admitted the task
+TRACE_EVENT(mp2_admit,
+        TP_PROTO(int pid, u64 period, u64 processing_time, int cpu),
+        TP_ARGS(pid, period, processing_time, cpu),
+        TP_STRUCT__entry(
+                __field(int, pid)
+                __field(u64, period)
+                __field(u64, processing_time)
+                __field(int, cpu)
+        ),
+        TP_fast_assign(
+                __entry->pid = pid;
+                __entry->period = period;
+                __entry->processing_time = processing_time;
+                __entry->cpu = cpu;
+        ),
+        TP_printk("pid=%d period_us=%llu processing_time_us=%llu cpu=%d %s",
+                  __entry->pid, __entry->period, __entry->processing_time, __entry->cpu,
+                  __entry->cpu >= 0 ? "accepted" : "rejected")
+);
+
+// mp2_deregister - a task leaves the scheduler
+TRACE_EVENT(mp2_deregister,
+        TP_PROTO(int pid, int cpu, u64 jobs, u64 missed),
+        TP_ARGS(pid, cpu, jobs, missed),
+        TP_STRUCT__entry(
+                __field(int, pid)
+                __field(int, cpu)
+                __field(u64, jobs)
+                __field(u64, missed)
+        ),
+        TP_fast_assign(
+                __entry->pid = pid;
+                __entry->cpu = cpu;
+                __entry->jobs = jobs;
+                __entry->missed = missed;
+        ),
+        TP_printk("pid=%d cpu=%d jobs=%llu missed=%llu",
+                  __entry->pid, __entry->cpu, __entry->jobs, __entry->missed)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mp2_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "mp2_ioctl.h"
+
+// mp2replay - replays a command log recorded with the module's record parameter as a load test
+//
+// Reads the struct mp2_record arrays of /sys/kernel/debug/mp2/commands<cpu> (copied somewhere first, the
+// files are consumed as they are read), merges them by time and forks one process per recorded task.
+// Each process issues its task's registration, updates, yields and deregistration through /dev/mp2 at
+// the same offsets from the start of the log as in the recording. Between a blocking yield returning
+// and its next command the process burns CPU, so a job occupies the CPU until the instant the original
+// task yielded; otherwise it sleeps. Submissions to sporadic servers and batch registrations and updates
+// are issued by the parent, with the recorded pids mapped to the replaying processes.
+//
+// Run it against a freshly loaded module. Output is CSV, one line per task:
+//   pid,replay_pid,commands,failed,mismatched,mean_skew_us,max_skew_us
+// failed counts commands that returned an error, mismatched the ones whose success differs from the
+// recording, and skew is how late each command was issued relative to its recorded offset
+
+#define START_DELAY_NS 200000000LL // the first command is replayed this long after the processes are forked
+
+struct replay_task {
+    int pid; // recorded pid
+    pid_t replay_pid;
+};
+
+// shared with the children through an anonymous shared mapping
+struct task_result {
+    int commands;
+    int failed;
+    int mismatched;
+    long long skew_sum;
+    long long skew_max;
+};
+
+struct mp2_record* records;
+int num_records = 0;
+struct replay_task* tasks;
+int num_tasks = 0;
+struct task_result* results;
+long long start_ns; // replay time of the first record
+long long first_record_ns;
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleep_until_ns(long long ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void burn_until_ns(long long ns) {
+    while (now_ns() < ns) {
+    }
+}
+
+// load_records - appends every record of path, returns -1 if it can't be read
+int load_records(const char* path) {
+    FILE* file = fopen(path, "rb");
+    struct mp2_record record;
+    int capacity = num_records;
+
+    if (!file) {
+        return -1;
+    }
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.op == 0 || record.pid <= 0) {
+            continue; // sub-buffer padding
+        }
+        if (num_records == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            records = realloc(records, capacity * sizeof(struct mp2_record));
+        }
+        records[num_records++] = record;
+    }
+    fclose(file);
+    return 0;
+}
+
+int compare_records(const void* a, const void* b) {
+    const struct mp2_record* x = a;
+    const struct mp2_record* y = b;
+    return (x->time_ns > y->time_ns) - (x->time_ns < y->time_ns);
+}
+
+int find_task(int pid) {
+    int t;
+    for (t = 0; t < num_tasks; t++) {
+        if (tasks[t].pid == pid) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+// collect_tasks - one replay task per pid that registered in the recording
+void collect_tasks(void) {
+    int i;
+
+    tasks = calloc(num_records, sizeof(struct replay_task));
+    for (i = 0; i < num_records; i++) {
+        char op = records[i].op;
+        if ((op == 'R' || op == 'S' || op == 'B') && find_task(records[i].pid) == -1) {
+            tasks[num_tasks++].pid = records[i].pid;
+        }
+    }
+}
+
+long long target_ns(const struct mp2_record* record) {
+    return start_ns + (long long) (record->time_ns - first_record_ns);
+}
+
+void account(struct task_result* result, const struct mp2_record* record, long long issued, int ret) {
+    long long skew = issued - target_ns(record);
+    if (skew < 0) {
+        skew = 0;
+    }
+    result->commands++;
+    result->failed += ret != 0;
+    result->mismatched += (ret == 0) != (record->ret == 0);
+    result->skew_sum += skew;
+    if (skew > result->skew_max) {
+        result->skew_max = skew;
+    }
+}
+
+// run_task - replays the commands the recorded task t issued for itself
+void run_task(int t) {
+    int dev = open(MP2_DEVICE_PATH, O_RDWR);
+    int registered = 0;
+    int in_job = 0;
+    int i;
+
+    if (dev < 0) {
+        _exit(1);
+    }
+    for (i = 0; i < num_records; i++) {
+        const struct mp2_record* record = &(records[i]);
+        struct mp2_register_args args = { .pid = 0, .period_us = record->period_us,
+                                          .processing_time_us = record->processing_time_us };
+        struct mp2_job_info info;
+        long long issued;
+        int ret = -1;
+
+        if (record->pid != tasks[t].pid || record->op == 'A') {
+            continue;
+        }
+        if (record->op == 'B') { // registered by the parent
+            registered |= record->ret == 0;
+            continue;
+        }
+        if (record->op == 'V') { // updated by the parent
+            continue;
+        }
+        if (in_job) {
+            burn_until_ns(target_ns(record));
+        }
+        else {
+            sleep_until_ns(target_ns(record));
+        }
+        in_job = 0;
+
+        issued = now_ns();
+        switch (record->op) {
+        case 'R':
+            ret = ioctl(dev, MP2_IOC_REGISTER, &args);
+            registered |= ret == 0;
+            break;
+        case 'S':
+            ret = ioctl(dev, MP2_IOC_REGISTER_SERVER, &args);
+            registered |= ret == 0;
+            break;
+        case 'U':
+            ret = ioctl(dev, MP2_IOC_UPDATE, &args);
+            break;
+        case 'Y':
+            ret = ioctl(dev, MP2_IOC_YIELD, &info);
+            in_job = ret == 0;
+            break;
+        case 'N':
+            ret = ioctl(dev, MP2_IOC_YIELD_NB, &info);
+            break;
+        case 'D':
+            ret = ioctl(dev, MP2_IOC_DEREGISTER);
+            registered &= ret != 0;
+            break;
+        default:
+            continue;
+        }
+        account(&(results[t]), record, issued, ret != 0 ? -errno : 0);
+    }
+    if (registered) {
+        ioctl(dev, MP2_IOC_DEREGISTER);
+    }
+    close(dev);
+    _exit(0);
+}
+
+// run_parent - replays the submissions and batches, which name other processes
+void run_parent(int dev) {
+    struct mp2_register_args* batch = calloc(num_records, sizeof(struct mp2_register_args));
+    int i = 0;
+
+    while (i < num_records) {
+        const struct mp2_record* record = &(records[i]);
+        int t = find_task(record->pid);
+        long long issued;
+        int ret;
+
+        if ((record->op != 'A' && record->op != 'B' && record->op != 'V') || t == -1) {
+            i++;
+            continue;
+        }
+        sleep_until_ns(target_ns(record));
+        issued = now_ns();
+        if (record->op == 'A') {
+            ret = ioctl(dev, MP2_IOC_SUBMIT, (unsigned long) tasks[t].replay_pid) != 0 ? -errno : 0;
+            account(&(results[t]), record, issued, ret);
+            i++;
+            continue;
+        }
+
+        // the records of one batch share their time
+        int count = 0, first = i, j;
+        for (; i < num_records && records[i].op == record->op && records[i].time_ns == record->time_ns && count < MP2_BATCH_MAX; i++) {
+            int bt = find_task(records[i].pid);
+            batch[count].pid = bt != -1 ? tasks[bt].replay_pid : -1;
+            batch[count].period_us = records[i].period_us;
+            batch[count].processing_time_us = records[i].processing_time_us;
+            count++;
+        }
+        struct mp2_batch_args args = { .tasks = (unsigned long) batch, .count = count };
+        ret = ioctl(dev, record->op == 'B' ? MP2_IOC_REGISTER_BATCH : MP2_IOC_UPDATE_BATCH, &args) != 0 ? -errno : 0;
+        for (j = first; j < i; j++) {
+            int bt = find_task(records[j].pid);
+            if (bt != -1) {
+                account(&(results[bt]), &(records[j]), issued, ret);
+            }
+        }
+    }
+    free(batch);
+}
+
+void usage(const char* name) {
+    printf("Usage: %s <command log> ...\n"
+           "  replays the merged logs, e.g. copies of /sys/kernel/debug/mp2/commands*, against /dev/mp2\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int i, t;
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (i = 1; i < argc; i++) {
+        if (load_records(argv[i]) != 0) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+    if (num_records == 0) {
+        fprintf(stderr, "no commands recorded\n");
+        return 1;
+    }
+    qsort(records, num_records, sizeof(struct mp2_record), compare_records);
+    collect_tasks();
+
+    int dev = open(MP2_DEVICE_PATH, O_RDWR);
+    if (dev < 0) {
+        perror(MP2_DEVICE_PATH);
+        return 1;
+    }
+    results = mmap(NULL, num_tasks * sizeof(struct task_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (num_tasks > 0 && results == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    first_record_ns = records[0].time_ns;
+    start_ns = now_ns() + START_DELAY_NS;
+    for (t = 0; t < num_tasks; t++) {
+        tasks[t].replay_pid = fork();
+        if (tasks[t].replay_pid == 0) {
+            run_task(t);
+        }
+        if (tasks[t].replay_pid < 0) {
+            perror("fork");
+            return 1;
+        }
+    }
+    run_parent(dev);
+    for (t = 0; t < num_tasks; t++) {
+        waitpid(tasks[t].replay_pid, NULL, 0);
+    }
+    close(dev);
+
+    printf("pid,replay_pid,commands,failed,mismatched,mean_skew_us,max_skew_us\n");
+    for (t = 0; t < num_tasks; t++) {
+        struct task_result* result = &(results[t]);
+        printf("%d,%d,%d,%d,%d,%.2f,%.2f\n", tasks[t].pid, tasks[t].replay_pid, result->commands, result->failed,
+               result->mismatched, result->commands ? result->skew_sum / 1000.0 / result->commands : 0.0,
+               result->skew_max / 1000.0);
+    }
+    return 0;
+}
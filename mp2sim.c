@@ -0,0 +1,439 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mp2_policy.h"
+
+// mp2sim - discrete-event simulator of the module's scheduling policy
+//
+// Every task set is partitioned over the simulated CPUs with the module's admission tests and placement,
+// then each CPU replays its tasks the way the module does: the first yield releases the first job, a job
+// that finishes yields through the same release state machine, the dispatcher runs the ready task the
+// policy orders first and a job that exhausts its processing time is throttled until its period ends.
+// The policy decisions come from mp2_policy.c, the same code the module is built with.
+//
+// With -P both every task set is run under rate monotonic and then under EDF, so the utilization each
+// policy admits can be compared on identical sets.
+//
+// Task sets are generated with UUniFast and log-uniform periods, or read from a file with one
+// "<period us>,<processing time us>" line per task and a blank line between sets.
+//
+// Output is CSV, one summary row per policy:
+//   policy,sets,schedulable,mean_util,mean_admitted_util,jobs,missed,preemptions,switches
+// or with -v one row per set and policy:
+//   policy,set,tasks,util,admitted,admitted_util,jobs,missed,preemptions,switches
+
+#define MAX_TASKS 256
+#define MAX_CPUS 64
+#define BASE_TIME 1000000000LL // simulated clock start in ns, release_time 0 means "not started yet"
+
+struct sim_task {
+    struct mp2_entity entity;
+    int cpu; // -1 if no CPU admitted it
+    s64 exec; // work per job in ns
+    s64 remaining; // work left in the current job
+    s64 budget; // budget left in the current job
+    int ready; // released and not finished
+    int throttled; // budget exhausted, waits for entity.deadline
+};
+
+struct sim_cpu {
+    struct sim_task* tasks[MAX_TASKS]; // sorted by period
+    struct mp2_entity entities[MAX_TASKS]; // copies of the tasks' parameters, in the same order
+    int n;
+    int util_sum;
+};
+
+struct sim_result {
+    int tasks;
+    int admitted;
+    int util;
+    int admitted_util;
+    long long jobs;
+    long long missed;
+    long long preemptions;
+    long long switches;
+};
+
+struct sim_summary {
+    int sets;
+    int schedulable;
+    double util_sum;
+    double admitted_util_sum;
+    long long jobs;
+    long long missed;
+    long long preemptions;
+    long long switches;
+};
+
+const char* policy_names[] = { "rm", "edf" };
+
+// options
+int policy = MP2_POLICY_RM; // policy of the current run
+int num_cpus = 1;
+int num_tasks = 8;
+double total_util = 0.6;
+int num_sets = 1000;
+int rta = 0;
+int worst_fit = 0;
+double exec_fraction = 1.0;
+s64 horizon_ms = 2000;
+u64 min_period_us = 10000;
+u64 max_period_us = 1000000;
+int verbose = 0;
+
+double uniform(void) {
+    return (random() + 1.0) / (RAND_MAX + 2.0);
+}
+
+// generate_set - UUniFast utilizations summing to total_util, discarding sets with a task above one CPU
+int generate_set(struct sim_task* tasks) {
+    double utils[MAX_TASKS];
+    int i;
+
+    while (1) {
+        double sum = total_util;
+        int valid = 1;
+        for (i = 0; i < num_tasks - 1; i++) {
+            double next = sum * pow(uniform(), 1.0 / (num_tasks - i - 1));
+            utils[i] = sum - next;
+            sum = next;
+        }
+        utils[num_tasks - 1] = sum;
+        for (i = 0; i < num_tasks; i++) {
+            if (utils[i] > 1.0) {
+                valid = 0;
+            }
+        }
+        if (valid) {
+            break;
+        }
+    }
+
+    for (i = 0; i < num_tasks; i++) {
+        double log_min = log((double) min_period_us);
+        double log_max = log((double) max_period_us);
+        u64 period = (u64) exp(log_min + uniform() * (log_max - log_min));
+        u64 processing_time = (u64) (utils[i] * period + 0.5);
+        if (processing_time == 0) {
+            processing_time = 1;
+        }
+        if (processing_time > period) {
+            processing_time = period;
+        }
+        mp2_entity_init(&(tasks[i].entity), period, processing_time);
+    }
+    return num_tasks;
+}
+
+// read_set - reads the next set from file, returns the number of tasks or 0 at the end of the file
+int read_set(FILE* file, struct sim_task* tasks) {
+    char* line = NULL;
+    size_t len = 0;
+    int n = 0;
+
+    while (getline(&line, &len, file) != -1) {
+        unsigned long long period, processing_time;
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%llu,%llu", &period, &processing_time) != 2) {
+            if (n > 0) {
+                break; // a blank line ends the set
+            }
+            continue;
+        }
+        if (n == MAX_TASKS || !mp2_params_valid(period, processing_time)) {
+            fprintf(stderr, "skipping task %llu,%llu\n", period, processing_time);
+            continue;
+        }
+        mp2_entity_init(&(tasks[n].entity), period, processing_time);
+        n++;
+    }
+    free(line);
+    return n;
+}
+
+int admits(struct sim_cpu* cpu, const struct mp2_entity* cand) {
+    if (policy == MP2_POLICY_EDF) {
+        return mp2_admit_edf(cpu->util_sum, cand);
+    }
+    if (mp2_admit_util(cpu->util_sum, cand)) {
+        return 1;
+    }
+    return rta && mp2_admit_rta(cpu->entities, cpu->n, cand);
+}
+
+// partition - places tasks in order like successive registrations, first-fit or worst-fit
+void partition(struct sim_task* tasks, int n, struct sim_cpu* cpus, struct sim_result* result) {
+    int i, c, j;
+
+    for (i = 0; i < n; i++) {
+        struct sim_task* task = &(tasks[i]);
+        struct sim_cpu* best = NULL;
+        int util = mp2_task_util(task->entity.processing_time, task->entity.period);
+
+        result->util += util;
+        task->cpu = -1;
+        for (c = 0; c < num_cpus; c++) {
+            if (cpus[c].n == MAX_TASKS || !admits(&(cpus[c]), &(task->entity))) {
+                continue;
+            }
+            if (best == NULL || (worst_fit && cpus[c].util_sum < best->util_sum)) {
+                best = &(cpus[c]);
+            }
+            if (!worst_fit) {
+                break;
+            }
+        }
+        if (best == NULL) {
+            continue;
+        }
+
+        // insert after every task with a period no longer than its own
+        for (j = best->n; j > 0 && best->tasks[j - 1]->entity.period > task->entity.period; j--) {
+            best->tasks[j] = best->tasks[j - 1];
+            best->entities[j] = best->entities[j - 1];
+        }
+        best->tasks[j] = task;
+        best->entities[j] = task->entity;
+        best->n++;
+        best->util_sum += util;
+        task->cpu = best - cpus;
+        result->admitted++;
+        result->admitted_util += util;
+    }
+}
+
+// start_job - the task's current job is released
+void start_job(struct sim_task* task) {
+    task->ready = 1;
+    task->throttled = 0;
+    task->remaining = task->exec;
+    task->budget = (s64) task->entity.processing_time * 1000;
+}
+
+// finish_job - the running job yields at now, returns whether the next job is released already
+void finish_job(struct sim_task* task, s64 now) {
+    task->ready = 0;
+    if (mp2_entity_yield(&(task->entity), now)) {
+        start_job(task);
+    }
+}
+
+// simulate_cpu - runs one CPU's tasks until horizon_ms has passed
+void simulate_cpu(struct sim_cpu* cpu, struct sim_result* result) {
+    struct sim_task* current = NULL;
+    s64 now = BASE_TIME;
+    s64 end = BASE_TIME + horizon_ms * 1000000;
+    int i;
+
+    // every task yields right after registering, which releases its first job
+    for (i = 0; i < cpu->n; i++) {
+        struct sim_task* task = cpu->tasks[i];
+        task->exec = (s64) (task->entity.processing_time * 1000 * exec_fraction);
+        if (task->exec <= 0) {
+            task->exec = 1;
+        }
+        finish_job(task, now);
+    }
+
+    while (now < end) {
+        struct sim_task* next = NULL;
+        s64 event = end;
+
+        // dispatch, the running task keeps the CPU unless a ready task is ordered strictly before it
+        for (i = 0; i < cpu->n; i++) {
+            struct sim_task* task = cpu->tasks[i];
+            if (task->ready && !task->throttled && (next == NULL || mp2_entity_before(policy, &(task->entity), &(next->entity)))) {
+                next = task;
+            }
+        }
+        if (current != NULL && current->ready && !current->throttled && next != current &&
+            !mp2_entity_before(policy, &(next->entity), &(current->entity))) {
+            next = current;
+        }
+        if (next != current) {
+            // a job that already ran and is not finished or throttled was preempted
+            if (current != NULL && current->ready && !current->throttled && current->remaining < current->exec) {
+                result->preemptions++;
+            }
+            if (next != NULL) {
+                result->switches++;
+            }
+            current = next;
+        }
+
+        // the next event is a release, a replenishment, or the running job finishing or running out of budget
+        for (i = 0; i < cpu->n; i++) {
+            struct sim_task* task = cpu->tasks[i];
+            if (!task->ready && task->entity.release_time < event) {
+                event = task->entity.release_time;
+            }
+            if (task->throttled && task->entity.deadline < event) {
+                event = task->entity.deadline;
+            }
+        }
+        if (current != NULL) {
+            s64 run = current->remaining < current->budget ? current->remaining : current->budget;
+            if (now + run < event) {
+                event = now + run;
+            }
+            current->remaining -= event - now;
+            current->budget -= event - now;
+        }
+        now = event;
+
+        if (current != NULL && current->remaining == 0) {
+            finish_job(current, now);
+        }
+        else if (current != NULL && current->budget == 0) {
+            current->throttled = 1;
+        }
+        for (i = 0; i < cpu->n; i++) {
+            struct sim_task* task = cpu->tasks[i];
+            if (!task->ready && task->entity.release_time <= now) {
+                start_job(task);
+            }
+            else if (task->throttled && task->entity.deadline <= now) {
+                // the throttled job missed its deadline, it continues with a fresh budget in the new period
+                mp2_entity_replenish(&(task->entity));
+                task->throttled = 0;
+                task->budget = (s64) task->entity.processing_time * 1000;
+            }
+        }
+    }
+
+    for (i = 0; i < cpu->n; i++) {
+        result->jobs += cpu->tasks[i]->entity.jobs;
+        result->missed += cpu->tasks[i]->entity.missed;
+    }
+}
+
+void usage(const char* name) {
+    printf("Usage: %s [-P rm|edf|both] [-m cpus] [-n tasks] [-u utilization] [-s sets] [-p min_ms,max_ms]\n"
+           "       [-e exec fraction] [-H horizon ms] [-S seed] [-f task set file] [-r] [-w] [-v]\n"
+           "  -P  scheduling policy (sched_policy), both runs every set under each (default rm)\n"
+           "  -u  total utilization of each generated set, across all CPUs\n"
+           "  -e  fraction of its processing time each job actually runs, above 1 overruns its budget\n"
+           "  -r  response-time analysis when the utilization bound fails (admission_mode=1)\n"
+           "  -w  worst-fit placement (placement=1)\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    static struct sim_task tasks[MAX_TASKS];
+    static struct sim_task run_tasks[MAX_TASKS];
+    static struct sim_cpu cpus[MAX_CPUS];
+    struct sim_summary summaries[2];
+    FILE* file = NULL;
+    int first_policy = MP2_POLICY_RM, last_policy = MP2_POLICY_RM;
+    int sets = 0;
+    int opt, p;
+
+    srandom(1);
+    while ((opt = getopt(argc, argv, "P:m:n:u:s:p:e:H:S:f:rwvh")) != -1) {
+        switch (opt) {
+        case 'P':
+            first_policy = strcmp(optarg, "edf") == 0 ? MP2_POLICY_EDF : MP2_POLICY_RM;
+            last_policy = strcmp(optarg, "rm") == 0 ? MP2_POLICY_RM : MP2_POLICY_EDF;
+            break;
+        case 'm': num_cpus = atoi(optarg); break;
+        case 'n': num_tasks = atoi(optarg); break;
+        case 'u': total_util = atof(optarg); break;
+        case 's': num_sets = atoi(optarg); break;
+        case 'p': {
+            unsigned long long min_ms, max_ms;
+            if (sscanf(optarg, "%llu,%llu", &min_ms, &max_ms) != 2 || min_ms == 0 || max_ms < min_ms ||
+                max_ms > MP2_MAX_TIME_US / 1000) {
+                usage(argv[0]);
+                return 1;
+            }
+            min_period_us = min_ms * 1000;
+            max_period_us = max_ms * 1000;
+            break;
+        }
+        case 'e': exec_fraction = atof(optarg); break;
+        case 'H': horizon_ms = atoll(optarg); break;
+        case 'S': srandom(atoi(optarg)); break;
+        case 'f':
+            file = fopen(optarg, "r");
+            if (!file) {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'r': rta = 1; break;
+        case 'w': worst_fit = 1; break;
+        case 'v': verbose = 1; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_cpus < 1 || num_cpus > MAX_CPUS || num_tasks < 1 || num_tasks > MAX_TASKS ||
+        total_util <= 0.0 || total_util > num_cpus || exec_fraction <= 0.0 || horizon_ms <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(summaries, 0, sizeof(summaries));
+    if (verbose) {
+        printf("policy,set,tasks,util,admitted,admitted_util,jobs,missed,preemptions,switches\n");
+    }
+    while (file != NULL || sets < num_sets) {
+        int n, c;
+
+        n = file != NULL ? read_set(file, tasks) : generate_set(tasks);
+        if (n == 0) {
+            break;
+        }
+
+        for (policy = first_policy; policy <= last_policy; policy++) {
+            struct sim_summary* summary = &(summaries[policy]);
+            struct sim_result result;
+
+            // every policy starts from the same unstarted task set
+            memcpy(run_tasks, tasks, n * sizeof(struct sim_task));
+            memset(&result, 0, sizeof(result));
+            memset(cpus, 0, sizeof(cpus));
+            result.tasks = n;
+
+            partition(run_tasks, n, cpus, &result);
+            for (c = 0; c < num_cpus; c++) {
+                simulate_cpu(&(cpus[c]), &result);
+            }
+
+            if (verbose) {
+                printf("%s,%d,%d,%.4f,%d,%.4f,%lld,%lld,%lld,%lld\n", policy_names[policy], sets, result.tasks,
+                       (double) result.util / MP2_UTIL_SCALE, result.admitted,
+                       (double) result.admitted_util / MP2_UTIL_SCALE, result.jobs, result.missed,
+                       result.preemptions, result.switches);
+            }
+            summary->sets++;
+            summary->schedulable += result.admitted == result.tasks && result.missed == 0;
+            summary->util_sum += (double) result.util / MP2_UTIL_SCALE;
+            summary->admitted_util_sum += (double) result.admitted_util / MP2_UTIL_SCALE;
+            summary->jobs += result.jobs;
+            summary->missed += result.missed;
+            summary->preemptions += result.preemptions;
+            summary->switches += result.switches;
+        }
+        sets++;
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+
+    if (!verbose) {
+        printf("policy,sets,schedulable,mean_util,mean_admitted_util,jobs,missed,preemptions,switches\n");
+        for (p = first_policy; p <= last_policy; p++) {
+            struct sim_summary* summary = &(summaries[p]);
+            printf("%s,%d,%d,%.4f,%.4f,%lld,%lld,%lld,%lld\n", policy_names[p], summary->sets, summary->schedulable,
+                   sets ? summary->util_sum / sets : 0.0, sets ? summary->admitted_util_sum / sets : 0.0,
+                   summary->jobs, summary->missed, summary->preemptions, summary->switches);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "mp2_ioctl.h"
+
+// mp2stress - registration and deregistration stress test
+//
+// Forks tasks - 1 idle children so there are that many pids to register, then for every round registers
+// all of them one by one and deregisters them again, timing each call with CLOCK_MONOTONIC. The tasks
+// are light enough (PERIOD_US / PROCESSING_TIME_US) that admission never rejects them, so the numbers
+// measure parsing, allocation, placement and publication, not admission failures. A failed call counts
+// in failed and is left out of the percentiles.
+//
+// Output is CSV: op,interface,tasks,calls,failed,p50_us,p90_us,p99_us,p999_us,max_us
+
+#define PERIOD_US 10000000
+#define PROCESSING_TIME_US 100
+
+int num_tasks = 1;
+int num_rounds = 1000;
+int use_proc = 0;
+pid_t* pids;
+int status_fd = -1;
+int dev_fd = -1;
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// write_command - one command through /proc/mp2/status, a failed command fails the write
+int write_command(const char* command) {
+    return write(status_fd, command, strlen(command)) < 0 ? -1 : 0;
+}
+
+int register_task(pid_t pid) {
+    if (use_proc) {
+        char command[64];
+        snprintf(command, sizeof(command), "R,%d,%dus,%dus", pid, PERIOD_US, PROCESSING_TIME_US);
+        return write_command(command);
+    }
+    struct mp2_register_args args = { .pid = pid, .period_us = PERIOD_US, .processing_time_us = PROCESSING_TIME_US };
+    return ioctl(dev_fd, MP2_IOC_REGISTER, &args);
+}
+
+// deregister_task - the ioctl only deregisters the calling process, other pids go through /proc/mp2/status
+int deregister_task(pid_t pid) {
+    if (use_proc || pid != getpid()) {
+        char command[64];
+        snprintf(command, sizeof(command), "D,%d", pid);
+        return write_command(command);
+    }
+    return ioctl(dev_fd, MP2_IOC_DEREGISTER);
+}
+
+int compare_ll(const void* a, const void* b) {
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+    return (x > y) - (x < y);
+}
+
+double percentile_us(long long* sorted, int count, int per_mille) {
+    if (count == 0) {
+        return 0.0;
+    }
+    int i = (int) ((long long) (count - 1) * per_mille / 1000);
+    return sorted[i] / 1000.0;
+}
+
+void report(const char* op, long long* samples, int count, int failed) {
+    qsort(samples, count, sizeof(long long), compare_ll);
+    printf("%s,%s,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f\n", op, use_proc ? "proc" : "ioctl", num_tasks, count + failed,
+           failed, percentile_us(samples, count, 500), percentile_us(samples, count, 900),
+           percentile_us(samples, count, 990), percentile_us(samples, count, 999), percentile_us(samples, count, 1000));
+}
+
+void usage(const char* name) {
+    printf("Usage: %s [-n rounds] [-k tasks] [-p]\n"
+           "  -n  register/deregister rounds (default 1000)\n"
+           "  -k  tasks registered per round, the module's max_tasks bounds it (default 1)\n"
+           "  -p  register through /proc/mp2/status instead of /dev/mp2\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:k:ph")) != -1) {
+        switch (opt) {
+        case 'n': num_rounds = atoi(optarg); break;
+        case 'k': num_tasks = atoi(optarg); break;
+        case 'p': use_proc = 1; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_rounds <= 0 || num_tasks <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    status_fd = open("/proc/mp2/status", O_WRONLY);
+    dev_fd = open(MP2_DEVICE_PATH, O_RDWR);
+    if (status_fd < 0 || (!use_proc && dev_fd < 0)) {
+        perror("open");
+        return 1;
+    }
+
+    // the first task is this process, the others are children that only wait to be killed
+    pids = calloc(num_tasks, sizeof(pid_t));
+    pids[0] = getpid();
+    int t;
+    for (t = 1; t < num_tasks; t++) {
+        pids[t] = fork();
+        if (pids[t] == 0) {
+            pause();
+            _exit(0);
+        }
+        if (pids[t] < 0) {
+            perror("fork");
+            num_tasks = t;
+            break;
+        }
+    }
+
+    long long calls = (long long) num_rounds * num_tasks;
+    long long* reg = calloc(calls, sizeof(long long));
+    long long* dereg = calloc(calls, sizeof(long long));
+    int reg_count = 0, reg_failed = 0, dereg_count = 0, dereg_failed = 0;
+    int round;
+
+    for (round = 0; round < num_rounds; round++) {
+        for (t = 0; t < num_tasks; t++) {
+            long long start = now_ns();
+            int ret = register_task(pids[t]);
+            long long elapsed = now_ns() - start;
+            if (ret == 0) {
+                reg[reg_count++] = elapsed;
+            }
+            else {
+                reg_failed++;
+            }
+        }
+        for (t = 0; t < num_tasks; t++) {
+            long long start = now_ns();
+            int ret = deregister_task(pids[t]);
+            long long elapsed = now_ns() - start;
+            if (ret == 0) {
+                dereg[dereg_count++] = elapsed;
+            }
+            else {
+                dereg_failed++;
+            }
+        }
+    }
+
+    for (t = 1; t < num_tasks; t++) {
+        kill(pids[t], SIGKILL);
+        waitpid(pids[t], NULL, 0);
+    }
+
+    printf("op,interface,tasks,calls,failed,p50_us,p90_us,p99_us,p999_us,max_us\n");
+    report("register", reg, reg_count, reg_failed);
+    report("deregister", dereg, dereg_count, dereg_failed);
+    return 0;
+}
@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "mp2_ioctl.h"
+
+// rtbench - real-time benchmark harness for the module and a stock SCHED_FIFO baseline
+//
+// Spawns one process per task spec. Every job burns its budget of CPU time and records, with
+// CLOCK_MONOTONIC, when it was released, when it started and when it finished:
+//   latency  = start - release
+//   response = finish - release
+//   missed   = finish > release + period
+//
+// Under mp2 each task registers through /dev/mp2 and yields with the ioctl, which returns the release
+// time of the job that starts. Under fifo each task runs at a SCHED_FIFO priority by period rank (the
+// same rate-monotonic order the module uses) and sleeps until its next release with clock_nanosleep.
+//
+// Output is percentile summaries per task and for all tasks together, as CSV:
+//   mode,task,period_us,budget_us,admitted,jobs,missed,lat_p50_us,lat_p90_us,lat_p99_us,lat_max_us,resp_p50_us,resp_p90_us,resp_p99_us,resp_max_us
+// or as a JSON array of objects with the same keys (-o json)
+
+#define MAX_TASKS 64
+#define MAX_PRIO 98
+#define START_DELAY_NS 200000000LL // every task releases its first job this long after the harness starts
+
+struct task_spec {
+    long long period_us;
+    long long budget_us;
+};
+
+// job_record - one job, ns relative to CLOCK_MONOTONIC
+struct job_record {
+    long long release;
+    long long start;
+    long long finish;
+};
+
+// shared with the children through an anonymous shared mapping
+struct task_result {
+    int admitted;
+    int jobs; // jobs recorded
+};
+
+struct task_spec specs[MAX_TASKS];
+int num_tasks = 0;
+int num_jobs = 100;
+int slack_percent = 10;
+int json = 0;
+double loops_per_us = 0.0;
+struct job_record* records; // num_tasks * num_jobs
+struct task_result* results;
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleep_until_ns(long long ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void burn_loops(long long loops) {
+    volatile long long sink = 0;
+    long long i;
+    for (i = 0; i < loops; i++) {
+        sink += i;
+    }
+}
+
+// calibrate - measures how many burn loops run per microsecond, so burn_us checks the thread's CPU clock
+// about once every 10us of work
+void calibrate(void) {
+    long long loops = 1000000;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        long long before = now_ns();
+        burn_loops(loops);
+        double rate = loops / ((now_ns() - before) / 1000.0);
+        if (rate > loops_per_us) {
+            loops_per_us = rate;
+        }
+    }
+}
+
+long long thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// burn_us - consumes us of CPU time, time spent preempted does not count towards it
+void burn_us(long long us) {
+    long long end = thread_cpu_ns() + us * 1000;
+    long long chunk = (long long) (10 * loops_per_us) + 1;
+    while (thread_cpu_ns() < end) {
+        burn_loops(chunk);
+    }
+}
+
+// rm_priority - SCHED_FIFO priority of a task by period rank, shortest period gets MAX_PRIO
+int rm_priority(int task) {
+    int rank = 0;
+    int i;
+    for (i = 0; i < num_tasks; i++) {
+        if (specs[i].period_us < specs[task].period_us) {
+            rank++;
+        }
+    }
+    return rank < MAX_PRIO ? MAX_PRIO - rank : 1;
+}
+
+void run_job(int task, int job, long long release) {
+    struct job_record* record = &(records[task * num_jobs + job]);
+    record->release = release;
+    record->start = now_ns();
+    burn_us(specs[task].budget_us);
+    record->finish = now_ns();
+}
+
+int run_mp2_task(int task, long long start) {
+    int fd = open(MP2_DEVICE_PATH, O_RDWR);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct mp2_register_args args;
+    memset(&args, 0, sizeof(args));
+    args.period_us = specs[task].period_us;
+    args.processing_time_us = specs[task].budget_us + specs[task].budget_us * slack_percent / 100;
+    if (args.processing_time_us > args.period_us) {
+        args.processing_time_us = args.period_us;
+    }
+    if (ioctl(fd, MP2_IOC_REGISTER, &args) != 0) {
+        close(fd);
+        return 1;
+    }
+    results[task].admitted = 1;
+
+    struct mp2_job_info job_info;
+    int job;
+    sleep_until_ns(start);
+    for (job = 0; job < num_jobs; job++) {
+        if (ioctl(fd, MP2_IOC_YIELD, &job_info) != 0) {
+            break;
+        }
+        run_job(task, job, job_info.release_ns);
+        results[task].jobs++;
+    }
+    ioctl(fd, MP2_IOC_DEREGISTER);
+    close(fd);
+    return 0;
+}
+
+int run_fifo_task(int task, long long start) {
+    struct sched_param param;
+    param.sched_priority = rm_priority(task);
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        return 1;
+    }
+    results[task].admitted = 1;
+
+    int job;
+    for (job = 0; job < num_jobs; job++) {
+        long long release = start + job * specs[task].period_us * 1000;
+        sleep_until_ns(release);
+        run_job(task, job, release);
+        results[task].jobs++;
+    }
+    return 0;
+}
+
+int compare_ll(const void* a, const void* b) {
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+    return (x > y) - (x < y);
+}
+
+double percentile_us(long long* sorted, int count, int per_mille) {
+    if (count == 0) {
+        return 0.0;
+    }
+    int i = (int) ((long long) (count - 1) * per_mille / 1000);
+    return sorted[i] / 1000.0;
+}
+
+// report - prints the summary of task, or of every task if task is -1
+void report(const char* mode, int task, int first) {
+    long long* latency = calloc(num_tasks * num_jobs, sizeof(long long));
+    long long* response = calloc(num_tasks * num_jobs, sizeof(long long));
+    int count = 0, missed = 0, admitted = 1;
+    int t, j;
+
+    for (t = 0; t < num_tasks; t++) {
+        if (task != -1 && t != task) {
+            continue;
+        }
+        admitted &= results[t].admitted;
+        for (j = 0; j < results[t].jobs; j++) {
+            struct job_record* record = &(records[t * num_jobs + j]);
+            latency[count] = record->start - record->release;
+            response[count] = record->finish - record->release;
+            if (response[count] > specs[t].period_us * 1000) {
+                missed++;
+            }
+            count++;
+        }
+    }
+    qsort(latency, count, sizeof(long long), compare_ll);
+    qsort(response, count, sizeof(long long), compare_ll);
+
+    char name[16];
+    long long period = task == -1 ? 0 : specs[task].period_us;
+    long long budget = task == -1 ? 0 : specs[task].budget_us;
+    if (task == -1) {
+        snprintf(name, sizeof(name), "all");
+    }
+    else {
+        snprintf(name, sizeof(name), "%d", task);
+    }
+
+    if (json) {
+        printf("%s  {\"mode\": \"%s\", \"task\": \"%s\", \"period_us\": %lld, \"budget_us\": %lld, \"admitted\": %d, "
+               "\"jobs\": %d, \"missed\": %d, \"lat_p50_us\": %.1f, \"lat_p90_us\": %.1f, \"lat_p99_us\": %.1f, "
+               "\"lat_max_us\": %.1f, \"resp_p50_us\": %.1f, \"resp_p90_us\": %.1f, \"resp_p99_us\": %.1f, "
+               "\"resp_max_us\": %.1f}",
+               first ? "" : ",\n", mode, name, period, budget, admitted, count, missed,
+               percentile_us(latency, count, 500), percentile_us(latency, count, 900),
+               percentile_us(latency, count, 990), percentile_us(latency, count, 1000),
+               percentile_us(response, count, 500), percentile_us(response, count, 900),
+               percentile_us(response, count, 990), percentile_us(response, count, 1000));
+    }
+    else {
+        printf("%s,%s,%lld,%lld,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               mode, name, period, budget, admitted, count, missed,
+               percentile_us(latency, count, 500), percentile_us(latency, count, 900),
+               percentile_us(latency, count, 990), percentile_us(latency, count, 1000),
+               percentile_us(response, count, 500), percentile_us(response, count, 900),
+               percentile_us(response, count, 990), percentile_us(response, count, 1000));
+    }
+    free(latency);
+    free(response);
+}
+
+// run_mode - runs every task under mode and prints its summaries
+int run_mode(const char* mode, int first) {
+    pid_t children[MAX_TASKS];
+    long long start = now_ns() + START_DELAY_NS;
+    int t;
+
+    memset(records, 0, num_tasks * num_jobs * sizeof(struct job_record));
+    memset(results, 0, num_tasks * sizeof(struct task_result));
+    for (t = 0; t < num_tasks; t++) {
+        children[t] = fork();
+        if (children[t] == 0) {
+            int ret = strcmp(mode, "mp2") == 0 ? run_mp2_task(t, start) : run_fifo_task(t, start);
+            _exit(ret);
+        }
+    }
+    for (t = 0; t < num_tasks; t++) {
+        int status = 0;
+        waitpid(children[t], &status, 0);
+        if (!results[t].admitted) {
+            fprintf(stderr, "%s: task %d (%lldus, %lldus) was not admitted\n", mode, t, specs[t].period_us, specs[t].budget_us);
+        }
+    }
+
+    for (t = 0; t < num_tasks; t++) {
+        report(mode, t, first && t == 0);
+    }
+    report(mode, -1, 0);
+    return 0;
+}
+
+int parse_spec(const char* arg, struct task_spec* spec) {
+    double period_ms, budget_ms;
+    if (sscanf(arg, "%lf:%lf", &period_ms, &budget_ms) != 2 || period_ms <= 0 || budget_ms <= 0 || budget_ms > period_ms) {
+        return -1;
+    }
+    spec->period_us = (long long) (period_ms * 1000);
+    spec->budget_us = (long long) (budget_ms * 1000);
+    return 0;
+}
+
+void usage(const char* name) {
+    printf("Usage: %s [-m mp2|fifo|both] [-j jobs] [-s slack %%] [-o csv|json] <period ms>:<budget ms> ...\n"
+           "  -m  scheduler to run under, both runs mp2 and then the SCHED_FIFO baseline (default both)\n"
+           "  -j  jobs per task (default 100)\n"
+           "  -s  extra processing time registered with mp2 on top of the budget (default 10%%)\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char* mode = "both";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:j:s:o:h")) != -1) {
+        switch (opt) {
+        case 'm': mode = optarg; break;
+        case 'j': num_jobs = atoi(optarg); break;
+        case 's': slack_percent = atoi(optarg); break;
+        case 'o': json = strcmp(optarg, "json") == 0; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (; optind < argc && num_tasks < MAX_TASKS; optind++) {
+        if (parse_spec(argv[optind], &(specs[num_tasks])) != 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        num_tasks++;
+    }
+    if (num_tasks == 0 || num_jobs <= 0 ||
+        (strcmp(mode, "mp2") != 0 && strcmp(mode, "fifo") != 0 && strcmp(mode, "both") != 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    records = mmap(NULL, num_tasks * num_jobs * sizeof(struct job_record), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    results = mmap(NULL, num_tasks * sizeof(struct task_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (records == MAP_FAILED || results == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    calibrate();
+
+    if (json) {
+        printf("[\n");
+    }
+    else {
+        printf("mode,task,period_us,budget_us,admitted,jobs,missed,lat_p50_us,lat_p90_us,lat_p99_us,lat_max_us,"
+               "resp_p50_us,resp_p90_us,resp_p99_us,resp_max_us\n");
+    }
+    if (strcmp(mode, "fifo") != 0) {
+        run_mode("mp2", 1);
+    }
+    if (strcmp(mode, "mp2") != 0) {
+        run_mode("fifo", strcmp(mode, "fifo") == 0);
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
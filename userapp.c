@@ -14,6 +14,7 @@ int fibonacci(int n) {
 int main(int argc, char *argv[]){
     if (argc <= 2) {
         printf("Not enough arguments\n");
+        printf("Usage: %s <period> <jobs> [processing time]\n", argv[0]);
         return 1;
     }
     
@@ -26,7 +27,7 @@ int main(int argc, char *argv[]){
     int pid = getpid();
     int period = atoi(argv[1]);
     int num_jobs = atoi(argv[2]);
-    int processing_time = 16099; // milliseconds for n = 45
+    int processing_time = argc > 3 ? atoi(argv[3]) : 16099; // milliseconds, defaults to n = 45
 
     // R,<pid>,<period>,<processing time>
     fprintf(write_ptr, "R,%d,%d,%d", pid, period, processing_time);